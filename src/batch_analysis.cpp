@@ -0,0 +1,423 @@
+#include "batch_analysis.h"
+#include "config_manager.h"
+#include "engine/bitboard.h"
+#include "engine/uci_engine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <csignal>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct AnalysisTask {
+    std::string id;
+    std::string fen;
+};
+
+/**
+ * One deque per worker. A worker takes from the front of its own deque and,
+ * once that is empty, steals from the back of the others, so a worker stuck
+ * on slow positions does not hold up work the rest could be doing.
+ */
+class WorkStealingQueue {
+public:
+    explicit WorkStealingQueue(size_t workers) : queues(workers) {}
+
+    void push(size_t worker, AnalysisTask task) {
+        std::lock_guard<std::mutex> lock(queues[worker].mutex);
+        queues[worker].tasks.push_back(std::move(task));
+    }
+
+    bool pop(size_t worker, AnalysisTask& task) {
+        {
+            WorkerQueue& own = queues[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.front());
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); ++i) {
+            WorkerQueue& victim = queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.back());
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t remaining() {
+        size_t count = 0;
+        for (WorkerQueue& queue : queues) {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            count += queue.tasks.size();
+        }
+        return count;
+    }
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<AnalysisTask> tasks;
+    };
+    std::vector<WorkerQueue> queues;
+};
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    if (text.size() < suffix.size()) return false;
+    return std::equal(suffix.rbegin(), suffix.rend(), text.rbegin(),
+                      [](char a, char b) { return std::tolower(a) == std::tolower(b); });
+}
+
+std::string normalizedFen(const ChessBoard& board) {
+    char fen[ChessBoard::FEN_BUFFER_SIZE];
+    board.get_fen(fen, sizeof(fen));
+    return fen;
+}
+
+// ===== EPD =====
+
+// Value of an EPD opcode such as id "name"; or hmvc 3;
+std::string epdOpcode(const std::string& operations, const std::string& opcode) {
+    std::istringstream stream(operations);
+    std::string operation;
+    while (std::getline(stream, operation, ';')) {
+        std::istringstream fields(operation);
+        std::string name;
+        fields >> name;
+        if (name != opcode) continue;
+        std::string value;
+        std::getline(fields >> std::ws, value);
+        if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+            value = value.substr(1, value.size() - 2);
+        }
+        return value;
+    }
+    return "";
+}
+
+bool loadEpd(const std::string& path, std::vector<AnalysisTask>& tasks) {
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+
+    std::string line;
+    int lineNumber = 0;
+    ChessBoard board;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream fields(line);
+        std::string placement, side, castling, enPassant;
+        if (!(fields >> placement >> side >> castling >> enPassant) || placement[0] == '#') continue;
+
+        // Plain FEN lines carry the clocks as fields 5 and 6
+        std::string operations;
+        std::getline(fields >> std::ws, operations);
+        std::string halfmove = epdOpcode(operations, "hmvc");
+        std::string fullmove = epdOpcode(operations, "fmvn");
+        std::istringstream clocks(operations);
+        std::string first, second;
+        if (clocks >> first >> second && std::all_of(first.begin(), first.end(), ::isdigit) &&
+            std::all_of(second.begin(), second.end(), ::isdigit)) {
+            halfmove = first;
+            fullmove = second;
+        }
+
+        std::string fen = placement + " " + side + " " + castling + " " + enPassant + " " +
+                          (halfmove.empty() ? "0" : halfmove) + " " + (fullmove.empty() ? "1" : fullmove);
+        if (!board.set_fen(fen)) {
+            std::cerr << "[ANLZ] Skipping invalid position at line " << lineNumber << std::endl;
+            continue;
+        }
+
+        std::string id = epdOpcode(operations, "id");
+        tasks.push_back({id.empty() ? "line" + std::to_string(lineNumber) : id, normalizedFen(board)});
+    }
+    return true;
+}
+
+// ===== PGN =====
+
+class PgnReader {
+public:
+    explicit PgnReader(std::vector<AnalysisTask>& tasks) : tasks(tasks) {}
+
+    void parse(const std::string& text) {
+        size_t i = 0;
+        while (i < text.size()) {
+            char c = text[i];
+            if (c == '[') {
+                size_t end = text.find(']', i);
+                if (end == std::string::npos) break;
+                if (started) finishGame();
+                readTag(text.substr(i + 1, end - i - 1));
+                i = end + 1;
+            } else if (c == '{') {
+                size_t end = text.find('}', i);
+                i = end == std::string::npos ? text.size() : end + 1;
+            } else if (c == ';') {
+                size_t end = text.find('\n', i);
+                i = end == std::string::npos ? text.size() : end + 1;
+            } else if (c == '(') {
+                variationDepth++;
+                i++;
+            } else if (c == ')') {
+                if (variationDepth > 0) variationDepth--;
+                i++;
+            } else if (std::isspace(static_cast<unsigned char>(c))) {
+                i++;
+            } else {
+                size_t end = text.find_first_of(" \t\r\n{}()[];", i);
+                if (end == std::string::npos) end = text.size();
+                if (variationDepth == 0) readToken(text.substr(i, end - i));
+                i = end;
+            }
+        }
+        finishGame();
+    }
+
+private:
+    std::vector<AnalysisTask>& tasks;
+    ChessBoard board;
+    std::string setupFen;
+    int variationDepth = 0;
+    int gameNumber = 0;
+    int ply = 0;
+    bool started = false;
+    bool hasTags = false;
+    bool broken = false;
+
+    void readTag(const std::string& tag) {
+        hasTags = true;
+        std::istringstream fields(tag);
+        std::string name;
+        fields >> name;
+        if (name != "FEN") return;
+        size_t open = tag.find('"');
+        size_t close = tag.rfind('"');
+        if (open != std::string::npos && close > open) setupFen = tag.substr(open + 1, close - open - 1);
+    }
+
+    void readToken(std::string token) {
+        if (token == "*" || token == "1-0" || token == "0-1" || token == "1/2-1/2") {
+            finishGame();
+            return;
+        }
+        if (token[0] == '$') return;  // NAG
+
+        // Strip a leading move number, "12." or "12..."
+        size_t start = 0;
+        while (start < token.size() && std::isdigit(static_cast<unsigned char>(token[start]))) start++;
+        if (start > 0 && start < token.size() && token[start] != '.') start = 0;
+        while (start < token.size() && token[start] == '.') start++;
+        token = token.substr(start);
+        if (token.empty()) return;
+
+        if (!started) startGame();
+        if (broken) return;
+
+        Move move = board.find_san_move(token);
+        if (move.is_null()) {
+            std::cerr << "[ANLZ] Game " << gameNumber << ": illegal or unknown move \"" << token
+                      << "\", skipping the rest of the game" << std::endl;
+            broken = true;
+            return;
+        }
+        addPosition();
+        board.make_move(move);
+        ply++;
+    }
+
+    void startGame() {
+        started = true;
+        broken = false;
+        ply = 0;
+        gameNumber++;
+        if (setupFen.empty() || !board.set_fen(setupFen)) {
+            if (!setupFen.empty()) std::cerr << "[ANLZ] Game " << gameNumber << ": invalid FEN tag" << std::endl;
+            board.set_initial_position();
+        }
+    }
+
+    void finishGame() {
+        if (!started && hasTags) startGame();  // positions given only by a FEN tag
+        if (started && !broken) {
+            MoveList moves;
+            board.generate_legal_moves(moves);
+            if (!moves.empty()) addPosition();
+        }
+        started = false;
+        hasTags = false;
+        setupFen.clear();
+        variationDepth = 0;
+    }
+
+    void addPosition() {
+        tasks.push_back({"game" + std::to_string(gameNumber) + ".ply" + std::to_string(ply), normalizedFen(board)});
+    }
+};
+
+bool loadPgn(const std::string& path, std::vector<AnalysisTask>& tasks) {
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+    std::stringstream content;
+    content << file.rdbuf();
+    PgnReader(tasks).parse(content.str());
+    return true;
+}
+
+bool startWorkerEngine(UCIEngine& engine, const AnalysisOptions& options, int depth, int moveTime) {
+    if (!engine.startEngine(false, options.enginePath)) return false;
+    engine.sendCommand("uci");
+    if (!engine.waitForResponse("uciok")) return false;
+    engine.sendCommand("isready");
+    if (!engine.waitForResponse("readyok")) return false;
+    engine.setDifficult(depth);
+    engine.setMoveTime(moveTime);
+    return true;
+}
+
+}  // namespace
+
+int runBatchAnalysis(const AnalysisOptions& options) {
+    // Log lines go to stderr so stdout carries only results
+    std::streambuf* stdoutBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+    std::ostream stdoutResults(stdoutBuffer);
+    struct RestoreCout {
+        std::streambuf* buffer;
+        ~RestoreCout() { std::cout.rdbuf(buffer); }
+    } restoreCout{stdoutBuffer};
+
+    // A dead engine must not kill the whole batch on the next write
+    std::signal(SIGPIPE, SIG_IGN);
+
+    ConfigManager configManager;
+    ConfigManager::Settings settings;
+    configManager.loadSettings(settings);
+    int depth = options.depth > 0 ? options.depth : settings.depthDifficulty;
+    int moveTime = options.moveTime >= 0 ? options.moveTime : settings.maxTimePerMove;
+
+    std::vector<AnalysisTask> tasks;
+    bool loaded = endsWith(options.inputPath, ".pgn") ? loadPgn(options.inputPath, tasks)
+                                                      : loadEpd(options.inputPath, tasks);
+    if (!loaded) {
+        std::cerr << "[ANLZ] Could not read " << options.inputPath << std::endl;
+        return 1;
+    }
+    if (tasks.empty()) {
+        std::cerr << "[ANLZ] No positions found in " << options.inputPath << std::endl;
+        return 1;
+    }
+
+    std::ofstream outputFile;
+    if (!options.outputPath.empty()) {
+        outputFile.open(options.outputPath);
+        if (!outputFile.is_open()) {
+            std::cerr << "[ANLZ] Could not open output file " << options.outputPath << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& results = options.outputPath.empty() ? stdoutResults : outputFile;
+
+    size_t jobs = options.jobs > 0 ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+    jobs = std::min(jobs, tasks.size());
+
+    std::vector<std::unique_ptr<UCIEngine>> pool;
+    for (size_t i = 0; i < jobs; ++i) {
+        auto engine = std::make_unique<UCIEngine>();
+        if (startWorkerEngine(*engine, options, depth, moveTime)) {
+            pool.push_back(std::move(engine));
+        } else {
+            std::cerr << "[ANLZ] Engine " << i << " failed to start" << std::endl;
+        }
+    }
+    if (pool.empty()) {
+        std::cerr << "[ANLZ] No engine available (" << options.enginePath << ")" << std::endl;
+        return 1;
+    }
+
+    std::cerr << "[ANLZ] " << tasks.size() << " positions, " << pool.size() << " engines, depth " << depth
+              << ", " << moveTime << " s per position" << std::endl;
+
+    // Deal the positions round robin, the stealing evens out the rest
+    WorkStealingQueue queue(pool.size());
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        queue.push(i % pool.size(), std::move(tasks[i]));
+    }
+
+    std::mutex outputMutex;
+    std::atomic<size_t> completed{0};
+    std::atomic<size_t> failed{0};
+    size_t total = tasks.size();
+
+    // Each worker only replaces its own pool slot
+    auto worker = [&](size_t index) {
+        AnalysisTask task;
+        while (queue.pop(index, task)) {
+            std::string bestMove;
+            std::string score;
+            bool ok = pool[index]->analyzeFen(task.fen, bestMove, score);
+
+            if (!ok) {
+                // Dead, or alive but hung and owing answers that would make every
+                // later position fail too: retry on a fresh engine. Handing the
+                // position back could lose it when the other workers already ran
+                // out of work and exited
+                std::cerr << "[ANLZ] Engine " << index << (pool[index]->isRunning() ? " did not answer" : " terminated")
+                          << ", restarting it" << std::endl;
+                auto restarted = std::make_unique<UCIEngine>();
+                if (startWorkerEngine(*restarted, options, depth, moveTime)) {
+                    pool[index] = std::move(restarted);
+                    ok = pool[index]->analyzeFen(task.fen, bestMove, score);
+                } else {
+                    std::cerr << "[ANLZ] Engine " << index << " could not be restarted" << std::endl;
+                    pool[index].reset();
+                }
+            }
+            if (!ok) failed++;
+
+            {
+                std::lock_guard<std::mutex> lock(outputMutex);
+                results << task.id << '\t' << (ok ? bestMove : "-") << '\t' << (ok && !score.empty() ? score : "-")
+                        << '\t' << task.fen << std::endl;
+                size_t done = ++completed;
+                if (done % 100 == 0 || done == total) {
+                    std::cerr << "[ANLZ] " << done << "/" << total << " positions" << std::endl;
+                }
+            }
+
+            // No engine left for this worker, the others steal what it still holds
+            if (!pool[index] || !pool[index]->isRunning()) return;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < pool.size(); ++i) {
+        workers.emplace_back(worker, i);
+    }
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+    pool.clear();
+
+    size_t unanalyzed = queue.remaining();
+    if (unanalyzed > 0) {
+        std::cerr << "[ANLZ] All engines terminated, " << unanalyzed << " positions left" << std::endl;
+    }
+    if (failed > 0) {
+        std::cerr << "[ANLZ] " << failed << " positions without an answer" << std::endl;
+    }
+    return unanalyzed == 0 && failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+// Headless batch analysis of EPD/PGN positions with a pool of UCI engines
+#ifndef BATCH_ANALYSIS_H
+#define BATCH_ANALYSIS_H
+
+#include <string>
+
+struct AnalysisOptions {
+    std::string inputPath;    // .epd (one position per line) or .pgn
+    std::string outputPath;   // empty for stdout
+    int jobs = 0;             // engine processes, 0 = one per CPU core
+    int depth = 0;            // 0 = depth_difficulty from config.yml
+    int moveTime = -1;        // seconds, -1 = max_time_per_move from config.yml
+    std::string enginePath = "/usr/games/gnuchess";
+};
+
+/**
+ * Analyze every position of the input file and stream one result line per
+ * position: id, bestmove, score and FEN separated by tabs.
+ * @return process exit code, 0 when every position got an answer
+ */
+int runBatchAnalysis(const AnalysisOptions& options);
+
+#endif // BATCH_ANALYSIS_H
@@ -1,27 +1,41 @@
 // Chess Game Logic Implementation
 #include "chess_game_logic.h"
+#include <algorithm>
 #include <iostream>
-#include <sstream>  
 #include <cctype>   
 #include <string>   
 #include <iomanip>
 
-ChessGame::ChessGame() : whiteTurn(true) {
+// ChessBoard::Piece (PAWN..KING, NONE) to the UI piece type
+static const PieceType BOARD_TO_PIECE_TYPE[] = {
+    PieceType::PAWN, PieceType::KNIGHT, PieceType::BISHOP, PieceType::ROOK,
+    PieceType::QUEEN, PieceType::KING, PieceType::NONE
+};
+
+// Points per ChessBoard::Piece (PAWN..KING)
+static const int PIECE_VALUES[] = {1, 3, 3, 5, 9, 0};
+
+ChessGame::ChessGame() {
+    moveHistory.reserve(512);
     initializeBoard();
 }
 
-const ChessPiece& ChessGame::getPiece(int row, int col) const {
-    return board[row][col];
+ChessPiece ChessGame::getPiece(int row, int col) const {
+    ChessBoard::Square square = board.from_row_col(row, col);
+    ChessBoard::Piece piece = board.get_piece_at(square);
+    if (piece == ChessBoard::NONE) return ChessPiece();
+    PieceColor color = (board.get_color_at(square) == ChessBoard::WHITE) ? PieceColor::WHITE : PieceColor::BLACK;
+    return ChessPiece(BOARD_TO_PIECE_TYPE[piece], color);
 }
 
 bool ChessGame::isWhiteTurn() const {
-    return whiteTurn;
+    return board.get_side_to_move() == ChessBoard::WHITE;
 }
 
 bool ChessGame::isFenMode() const { 
   return fenMode; }
 
-const std::vector<std::string>& ChessGame::getMoveHistory() const {
+const std::vector<Move>& ChessGame::getMoveHistory() const {
     return moveHistory;
 }
 
@@ -47,484 +61,286 @@ bool ChessGame::fromChessNotation(const std::string& notation, int& row, int& co
     return (col >= 0 && col < 8 && row >= 0 && row < 8);
 }
 
-bool ChessGame::fromChessMoveNotation(const std::string& moveNotation, int& fromRow, int& fromCol, int& toRow, int& toCol) const {
-    if (moveNotation.length() != 4) return false;
-    
-    // Extract source and destination notations
-    std::string fromNotation = moveNotation.substr(0, 2);
-    std::string toNotation = moveNotation.substr(2, 2);
-    
-    // Convert using existing fromChessNotation function
-    if (!fromChessNotation(fromNotation, fromRow, fromCol)) return false;
-    if (!fromChessNotation(toNotation, toRow, toCol)) return false;
-    
-    return true;
+void ChessGame::getMoveSquares(Move move, int& fromRow, int& fromCol, int& toRow, int& toCol) const {
+    std::pair<int, int> from = board.to_row_col(static_cast<ChessBoard::Square>(move.from()));
+    std::pair<int, int> to = board.to_row_col(static_cast<ChessBoard::Square>(move.to()));
+    fromRow = from.first;
+    fromCol = from.second;
+    toRow = to.first;
+    toCol = to.second;
 }
 
 std::string ChessGame::boardToFEN() const {
-  std::stringstream fen;
-
-  // Piece placement
-  for (int row = 0; row < 8; row++) {
-    int emptyCount = 0;
-
-    for (int col = 0; col < 8; col++) {
-      const ChessPiece& piece = board[row][col];
-
-      if (piece.type == PieceType::NONE) {
-        emptyCount++;
-      } else {
-        if (emptyCount > 0) {
-          fen << emptyCount;
-          emptyCount = 0;
-        }
-
-        char pieceChar = getPieceChar(piece);
-        fen << pieceChar;
-      }
-    }
-
-    if (emptyCount > 0) {
-      fen << emptyCount;
-    }
-
-    if (row < 7) {
-      fen << '/';
-    }
-  }
-
-  // Add other FEN components (you'll need to track these in your game state)
-  fen << " b KQkq - 0 1";  // Default values for new game
-
-  return fen.str();
+  char fen[ChessBoard::FEN_BUFFER_SIZE];
+  board.get_fen(fen, sizeof(fen));
+  return fen;
 }
 
 void ChessGame::initializeBoard(const std::string& fen) {
-  // Copy standard board
   if (fen.empty()) {
-    for (int row = 0; row < 8; row++) {
-      for (int col = 0; col < 8; col++) {
-        board[row][col] = STANDARD_BOARD[row][col];
-      }
-    }
+    board.set_initial_position();
   }
   else {
-    clearBoard();
-    std::istringstream fenStream(fen);
-    std::string piecePlacement;
-    fenStream >> piecePlacement;
-
-    int row = 0;
-    int col = 0;
-
-    for (char c : piecePlacement) {
-      if (c == '/') {
-        // Move to next row
-        row++;
-        col = 0;
-      } else if (std::isdigit(c)) {
-        // Skip empty squares
-        int emptySquares = c - '0';
-        col += emptySquares;
-      } else {
-        // Place a piece
-        ChessPiece piece = charToPiece(c);
-        if (row < 8 && col < 8) {
-          board[row][col] = piece;
-        }
-        col++;
-      }
-      if (row >= 8) break;
+    if (!board.set_fen(fen)) {
+      std::cout << "[GAME] Invalid FEN, loading the initial position: " << fen << std::endl;
+      board.set_initial_position();
     }
     fenMode = true;
-    loadCapturedPieces();
   }
+  countMaterial();
+  drawn = false;
+  historyPly = 0;
+  recordPosition();
+  // With black to move the engine plays first (see isEngineTurn)
+  pending_move = Move();
+  if (!fen.empty()) loadCapturedPieces();
 }
 
-void ChessGame::clearBoard() {
-    for (int row = 0; row < 8; row++) {
-        for (int col = 0; col < 8; col++) {
-            board[row][col] = ChessPiece{};
-        }
+// Recount material from the piece bitboards, only needed when a position is loaded
+void ChessGame::countMaterial() {
+  for (int color = ChessBoard::WHITE; color <= ChessBoard::BLACK; color++) {
+    material[color] = 0;
+    for (int piece = ChessBoard::PAWN; piece <= ChessBoard::KING; piece++) {
+      ChessBoard::Bitboard pieces = board.get_pieces(static_cast<ChessBoard::Piece>(piece),
+                                                     static_cast<ChessBoard::Color>(color));
+      pieceCounts[color][piece] = __builtin_popcountll(pieces);
+      material[color] += pieceCounts[color][piece] * PIECE_VALUES[piece];
     }
+  }
+  materialDirty = true;
+}
+
+void ChessGame::recordPosition() {
+  PlyRecord& record = positionHistory[historyPly % HISTORY_RING_SIZE];
+  record.key = board.get_hash();
+  record.halfmoveClock = static_cast<uint16_t>(board.get_halfmove_clock());
+  historyPly++;
 }
 
+// Occurrences of the current position, itself included. Only positions with
+// the same side to move since the last irreversible move can match. The scan
+// stops at HISTORY_RING_SIZE - 1 (255) plies back; play ends at the 50-move
+// draw long before that, and plies before a FEN load are never recorded.
+int ChessGame::getRepetitionCount() const {
+  if (historyPly == 0) return 0;
+  const PlyRecord& current = positionHistory[(historyPly - 1) % HISTORY_RING_SIZE];
+  int reach = std::min({static_cast<int>(current.halfmoveClock), historyPly - 1, HISTORY_RING_SIZE - 1});
+
+  int count = 1;
+  for (int back = 2; back <= reach; back += 2) {
+    if (positionHistory[(historyPly - 1 - back) % HISTORY_RING_SIZE].key == current.key) count++;
+  }
+  return count;
+}
+
+// Captured pieces of a loaded position: whatever is missing from the standard set
 void ChessGame::loadCapturedPieces() {
   whiteCapturedPieces.clear();
   blackCapturedPieces.clear();
+  pointsWhite = 0;
+  pointsBlack = 0;
 
-  // Standard piece counts: [PAWN, ROOK, KNIGHT, BISHOP, QUEEN, KING]
+  // Standard piece counts: [PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING]
   const int standardCounts[6] = {8, 2, 2, 2, 1, 1};
 
-  int currentWhite[6] = {0};
-  int currentBlack[6] = {0};
-
-  // Count current pieces
-  for (int row = 0; row < 8; row++) {
-    for (int col = 0; col < 8; col++) {
-      ChessPiece piece = board[row][col];
-      if (!piece.isEmpty()) {
-        int typeIndex = static_cast<int>(piece.type) - 1;  // Convert to 0-based
-        if (piece.color == PieceColor::WHITE) {
-          currentWhite[typeIndex]++;
-        } else {
-          currentBlack[typeIndex]++;
-        }
-      }
-    }
-  }
-
-  // Find captured pieces
-  for (int i = 0; i < 6; i++) {
-    PieceType pieceType = static_cast<PieceType>(i + 1);
-
+  for (int piece = ChessBoard::PAWN; piece <= ChessBoard::KING; piece++) {
     // White captured black pieces
-    int missingBlack = standardCounts[i] - currentBlack[i];
+    int missingBlack = standardCounts[piece] - pieceCounts[ChessBoard::BLACK][piece];
     for (int j = 0; j < missingBlack; j++) {
-      whiteCapturedPieces.push_back(ChessPiece(pieceType, PieceColor::BLACK));
+      whiteCapturedPieces.push_back(ChessPiece(BOARD_TO_PIECE_TYPE[piece], PieceColor::BLACK));
+      pointsWhite += PIECE_VALUES[piece];
     }
 
     // Black captured white pieces
-    int missingWhite = standardCounts[i] - currentWhite[i];
+    int missingWhite = standardCounts[piece] - pieceCounts[ChessBoard::WHITE][piece];
     for (int j = 0; j < missingWhite; j++) {
-      blackCapturedPieces.push_back(ChessPiece(pieceType, PieceColor::WHITE));
+      blackCapturedPieces.push_back(ChessPiece(BOARD_TO_PIECE_TYPE[piece], PieceColor::WHITE));
+      pointsBlack += PIECE_VALUES[piece];
     }
   }
-  // refresh points
-  calculatePoints();
+  materialDirty = true;
 }
 
-void ChessGame::calculatePoints() {
-    pointsWhite = 0;
-    pointsBlack = 0;
-
-    auto pieceValue = [](PieceType type) {
-        switch (type) {
-            case PieceType::PAWN: return 1;
-            case PieceType::KNIGHT: return 3;
-            case PieceType::BISHOP: return 3;
-            case PieceType::ROOK: return 5;
-            case PieceType::QUEEN: return 9;
-            default: return 0;
-        }
-    };
-
-    for (const auto& piece : whiteCapturedPieces) {
-        pointsWhite += pieceValue(piece.type);
-    }
-
-    for (const auto& piece : blackCapturedPieces) {
-        pointsBlack += pieceValue(piece.type);
+/**
+ * Look up a legal move of the side to move by its squares
+ * Promotions default to a queen.
+ * @return the matching move, a null move if there is none
+ */
+Move ChessGame::findLegalMove(int fromRow, int fromCol, int toRow, int toCol) const {
+    int from = board.from_row_col(fromRow, fromCol);
+    int to = board.from_row_col(toRow, toCol);
+
+    MoveList moves;
+    board.generate_legal_moves(moves);
+    for (const Move& move : moves) {
+        if (move.from() != from || move.to() != to) continue;
+        if (move.is_promotion() && move.promotion_piece() != ChessBoard::QUEEN) continue;
+        return move;
     }
+    return Move();
 }
 
 bool ChessGame::isValidMove(bool& isCastling, int fromRow, int fromCol, int toRow, int toCol) const {
-    // Can't move to the same square
-    if (fromRow == toRow && fromCol == toCol) return false;
- 
-    const ChessPiece& fromPiece = board[fromRow][fromCol];
-    const ChessPiece& toPiece = board[toRow][toCol];
-    
-    // Can't move empty squares
-    if (fromPiece.isEmpty()) return false;
-    
-    // Can't capture own pieces
-    if (!toPiece.isEmpty() && fromPiece.color == toPiece.color) return false;
-    
-    // Pawn move validation
-    if (fromPiece.type == PieceType::PAWN) {
-        int direction = (fromPiece.color == PieceColor::WHITE) ? -1 : 1;
-        int startRow = (fromPiece.color == PieceColor::WHITE) ? 6 : 1;
-        
-        // Forward move (1 square)
-        if (fromCol == toCol && toRow == fromRow + direction && toPiece.isEmpty()) {
-            return true;
-        }
-        
-        // Initial double move (2 squares)
-        if (fromCol == toCol && fromRow == startRow && 
-            toRow == fromRow + 2 * direction && toPiece.isEmpty() && 
-            board[fromRow + direction][fromCol].isEmpty()) {
-            return true;
-        }
-        
-        // Capture (diagonal)
-        if (abs(fromCol - toCol) == 1 && toRow == fromRow + direction && 
-            !toPiece.isEmpty() && toPiece.color != fromPiece.color) {
-            return true;
-        }
-        
-        // TODO: Add en passant and promotion logic
-        return false;
-    }
+    Move move = findLegalMove(fromRow, fromCol, toRow, toCol);
+    isCastling = move.is_castling();
+    return !move.is_null();
+}
 
-    if (fromPiece.type == PieceType::KING) {
-        std::cout << "[GAME] King move.." << std::endl;
-        // Check for castling - king moves two squares horizontally
-        if (fromRow == toRow && abs(fromCol - toCol) == 2) {
-            // Castling conditions:
-            // 1. King must not have moved before
-            // 2. Rook must not have moved before
-            // 3. No pieces between king and rook
-            // 4. King must not be in check
-            // 5. King must not pass through check
-            // 6. King must not end up in check
-            
-            // Determine if kingside or queenside castling
-            bool isKingside = (toCol > fromCol);
-            int rookCol = isKingside ? 7 : 0;
-            int direction = isKingside ? 1 : -1;
-            
-            // Check if king and rook are in starting positions
-            if (fromPiece.hasMoved) return false;
-            std::cout << "[GAME] King never moved.." << std::endl;
-            
-            const ChessPiece& rook = board[fromRow][rookCol];
-            if (rook.isEmpty() || rook.type != PieceType::ROOK || rook.hasMoved || rook.color != fromPiece.color) {
-                return false;
-            }
-            std::cout << "[GAME] Rook castelling never moved.." << std::endl;
-            
-            // Check that squares between king and rook are empty
-            for (int col = fromCol + direction; col != rookCol; col += direction) {
-                if (!board[fromRow][col].isEmpty()) {
-                    return false;
-                }
-            }
-            std::cout << "[GAME] Castelling line is free.." << std::endl;
-            std::cout << "[GAME] Castelling Approved" << std::endl;
-            std::cout << "[GAME] King valid move" << std::endl;
-
-            // return -1 on invalid input
-            
-            isCastling = true;
-            return true;
-        }
-        
-        // Regular king move (one square in any direction)
-        if (abs(fromRow - toRow) <= 1 && abs(fromCol - toCol) <= 1) {
-            // Mark king as moved (handled in movePiece)
-            return true;
-        }
-        
-        return false;
-    }
-    
-    // Knight move validation
-    if (fromPiece.type == PieceType::KNIGHT) {
-        // Knight moves in L-shape: 2 squares in one direction, 1 square perpendicular
-        int rowDiff = abs(fromRow - toRow);
-        int colDiff = abs(fromCol - toCol);
-        
-        // Valid knight moves: (2,1) or (1,2)
-        if ((rowDiff == 2 && colDiff == 1) || (rowDiff == 1 && colDiff == 2)) {
-            return true;
-        }
-        
-        return false;
+/**
+ * All legal destination squares of the piece on a square
+ * Meant to be computed once when a piece is selected, then reused to
+ * validate clicks and draw move targets (see isDestination).
+ * @return bitboard of destinations, 0 if the square holds no piece of the side to move
+ */
+ChessBoard::Bitboard ChessGame::getLegalDestinations(int row, int col) const {
+    int from = board.from_row_col(row, col);
+
+    MoveList moves;
+    board.generate_legal_moves(moves);
+    ChessBoard::Bitboard destinations = 0;
+    for (const Move& move : moves) {
+        if (move.from() == from) destinations |= 1ULL << move.to();
     }
-    
-    // Bishop move validation
-    if (fromPiece.type == PieceType::BISHOP) {
-        // Bishop moves diagonally - row and column differences must be equal
-        int rowDiff = abs(fromRow - toRow);
-        int colDiff = abs(fromCol - toCol);
-        
-        // Valid bishop moves: same absolute difference in rows and columns
-        if (rowDiff == colDiff && rowDiff > 0) {
-            // Check for pieces blocking the diagonal path
-            int rowStep = (toRow > fromRow) ? 1 : -1;
-            int colStep = (toCol > fromCol) ? 1 : -1;
-            
-            int currentRow = fromRow + rowStep;
-            int currentCol = fromCol + colStep;
-            
-            // Check all squares along the diagonal path
-            while (currentRow != toRow && currentCol != toCol) {
-                if (board[currentRow][currentCol].type != PieceType::NONE) {
-                    return false; // Path is blocked
-                }
-                currentRow += rowStep;
-                currentCol += colStep;
-            }
-            
-            return true;
-        }
-        
-        return false;
-    }
-    // Rook move validation
-    if (fromPiece.type == PieceType::ROOK) {
-        // Rook moves in straight lines only
-        bool isHorizontalMove = (fromRow == toRow && fromCol != toCol);
-        bool isVerticalMove = (fromCol == toCol && fromRow != toRow);
-        
-        if (!isHorizontalMove && !isVerticalMove) {
-            return false;
-        }
-        
-        // Check for pieces blocking the path
-        int rowStep = 0;
-        int colStep = 0;
-        
-        if (fromRow != toRow) {
-            rowStep = (toRow > fromRow) ? 1 : -1;
-        }
-        if (fromCol != toCol) {
-            colStep = (toCol > fromCol) ? 1 : -1;
-        }
-        
-        int currentRow = fromRow + rowStep;
-        int currentCol = fromCol + colStep;
-        
-        // Check all squares along the path
-        while (currentRow != toRow || currentCol != toCol) {
-            if (board[currentRow][currentCol].type != PieceType::NONE) {
-                return false; // Path is blocked
-            }
-            currentRow += rowStep;
-            currentCol += colStep;
-        }
-        
-        return true;
-    }
-    if (fromPiece.type == PieceType::QUEEN) {
-        int rowDiff = abs(fromRow - toRow);
-        int colDiff = abs(fromCol - toCol);
-        
-        // Queen moves like a rook (straight lines) or bishop (diagonals)
-        bool isStraightMove = (fromRow == toRow || fromCol == toCol);
-        bool isDiagonalMove = (rowDiff == colDiff && rowDiff > 0);
-        
-        if (!isStraightMove && !isDiagonalMove) {
-            return false;
-        }
-        
-        // Check for pieces blocking the path
-        int rowStep = 0;
-        int colStep = 0;
-        
-        if (fromRow != toRow) {
-            rowStep = (toRow > fromRow) ? 1 : -1;
-        }
-        if (fromCol != toCol) {
-            colStep = (toCol > fromCol) ? 1 : -1;
-        }
-        
-        int currentRow = fromRow + rowStep;
-        int currentCol = fromCol + colStep;
-        
-        // Check all squares along the path
-        while (currentRow != toRow || currentCol != toCol) {
-            if (board[currentRow][currentCol].type != PieceType::NONE) {
-                return false; // Path is blocked
-            }
-            currentRow += rowStep;
-            currentCol += colStep;
-        }
-        
-        return true;
+    return destinations;
+}
+
+bool ChessGame::isDestination(ChessBoard::Bitboard destinations, int row, int col) {
+    if (row < 0 || row > 7 || col < 0 || col > 7) return false;
+    return (destinations >> ((7 - row) * 8 + col)) & 1;
+}
+
+/**
+ * Split the destinations of the piece on a square by static exchange
+ * evaluation: moves that lose material and captures that win it
+ * @param losing: destinations where the piece is lost for less than it takes
+ * @param winning: captures that come out ahead
+ */
+void ChessGame::classifyDestinations(int row, int col, ChessBoard::Bitboard& losing, ChessBoard::Bitboard& winning) const {
+    int from = board.from_row_col(row, col);
+    losing = 0;
+    winning = 0;
+
+    MoveList moves;
+    board.generate_legal_moves(moves);
+    for (const Move& move : moves) {
+        if (move.from() != from) continue;
+        if (move.is_promotion() && move.promotion_piece() != ChessBoard::QUEEN) continue;
+        int gain = board.see(move);
+        if (gain < 0) losing |= 1ULL << move.to();
+        else if (gain > 0 && (move.is_capture() || move.is_promotion())) winning |= 1ULL << move.to();
     }
-    // For other pieces, allow any move (basic implementation)
-    return true;
+}
+
+// Pieces of the side to move that the opponent can win by capturing
+ChessBoard::Bitboard ChessGame::getHangingPieces() const {
+    return board.hanging_pieces(board.get_side_to_move());
 }
 
 bool ChessGame::isInCheck(int& kingRow, int& kingCol) const { 
-  ChessBoard bitboard;
-  ChessBoard::Square king_pos = bitboard.set_custom_position(boardToFEN());
-  std::pair<int, int> kingPos = bitboard.to_row_col(king_pos);
+  // King of the side to move, only the checkers against it are computed
+  ChessBoard::Square king_pos = board.find_king_square(board.get_side_to_move());
+  if (king_pos == ChessBoard::NO_SQ) return false;
+  std::pair<int, int> kingPos = board.to_row_col(king_pos);
   kingRow = kingPos.first;
   kingCol = kingPos.second;
-  bool check = bitboard.is_king_in_check(ChessBoard::Color::WHITE);
+  bool check = board.checkers() != 0;
   std::cout << "[GAME] isInCheck: " << (check ? "yes" : "no") << "\n";
   return check;
 }
 
 bool ChessGame::would_move_leave_king_in_check(int fromRow, int fromCol, int toRow, int toCol) const {
-  ChessBoard bitboard;
-  ChessBoard::Square king_pos = bitboard.set_custom_position(boardToFEN());
-  bool wcheck = bitboard.would_move_leave_king_in_check(
-      bitboard.from_row_col(fromRow, fromCol),
-      bitboard.from_row_col(toRow, toCol)
+  bool wcheck = board.would_move_leave_king_in_check(
+      board.from_row_col(fromRow, fromCol),
+      board.from_row_col(toRow, toCol)
     );
   std::cout << "[GAME] would move leave king in check: " << (wcheck ? "yes" : "no") << "\n";
   return wcheck;
 }
 
 bool ChessGame::movePiece(int fromRow, int fromCol, int toRow, int toCol) {
-    bool isCastling = false;
-    if (!isValidMove(isCastling, fromRow, fromCol, toRow, toCol)) {
+    if (drawn) {
+        std::cout << "[GAME] The game is drawn. Move invalid!" << std::endl;
         return false;
     }
-
-    if (whiteTurn &&  would_move_leave_king_in_check(fromRow, fromCol, toRow, toCol)) {
-        std::cout << "[GAME] Move would leave king in check. Move invalid!" << std::endl;
+    // Only legal moves are generated, so king safety is already covered
+    Move legalMove = findLegalMove(fromRow, fromCol, toRow, toCol);
+    if (legalMove.is_null()) {
+        std::cout << "[GAME] Move is not legal. Move invalid!" << std::endl;
         return false;
     }
- 
-    ChessPiece& fromPiece = board[fromRow][fromCol];
-    ChessPiece toPiece   = board[toRow][toCol];
-    
-    // Handle castling
-    if (fromPiece.type == PieceType::KING && isCastling) {
-        handleCastling(fromRow, fromCol, toRow, toCol);
+    applyMove(legalMove);
+    return true;
+}
+
+// Engine moves arrive already packed, only checked against the legal moves
+bool ChessGame::playMove(Move move) {
+    if (drawn) {
+        std::cout << "[GAME] The game is drawn. Move invalid!" << std::endl;
+        return false;
     }
-    
-    // Mark king as moved if it moves
-    if (fromPiece.type == PieceType::KING) {
-        fromPiece.hasMoved = true;
+    MoveList moves;
+    board.generate_legal_moves(moves);
+    if (move.is_null() || std::find(moves.begin(), moves.end(), move) == moves.end()) {
+        std::cout << "[GAME] Move is not legal. Move invalid!" << std::endl;
+        return false;
     }
-    
-    // Record the move in chess notation
-    std::string move = toChessNotation(fromRow, fromCol) + toChessNotation(toRow, toCol);
+    applyMove(move);
+    return true;
+}
+
+void ChessGame::applyMove(Move legalMove) {
+    bool whiteTurn = isWhiteTurn();
+    ChessBoard::Color us = whiteTurn ? ChessBoard::WHITE : ChessBoard::BLACK;
+    ChessBoard::Color them = whiteTurn ? ChessBoard::BLACK : ChessBoard::WHITE;
+    ChessBoard::Piece captured = legalMove.is_en_passant()
+        ? ChessBoard::PAWN
+        : board.get_piece_at(static_cast<ChessBoard::Square>(legalMove.to()));
     
     // Save captured pieces 
-    if (!toPiece.isEmpty() && whiteTurn) whiteCapturedPieces.push_back(toPiece);
-    else if (!toPiece.isEmpty() && !whiteTurn) blackCapturedPieces.push_back(toPiece);
+    if (captured != ChessBoard::NONE) {
+      ChessPiece toPiece(BOARD_TO_PIECE_TYPE[captured], whiteTurn ? PieceColor::BLACK : PieceColor::WHITE);
+      if (whiteTurn) {
+        whiteCapturedPieces.push_back(toPiece);
+        pointsWhite += PIECE_VALUES[captured];
+      } else {
+        blackCapturedPieces.push_back(toPiece);
+        pointsBlack += PIECE_VALUES[captured];
+      }
+      pieceCounts[them][captured]--;
+      material[them] -= PIECE_VALUES[captured];
+      materialDirty = true;
+    }
 
     // Pawn coronation 
-    if (fromPiece.type == PieceType::PAWN && (toRow == 0 || toRow == 7)) 
+    if (legalMove.is_promotion()) {
       std::cout << "[GAME] PAWN promoted!" << std::endl;
-    if (fromPiece.type == PieceType::PAWN && whiteTurn && toRow == 0) fromPiece.type = PieceType::QUEEN;
-    if (fromPiece.type == PieceType::PAWN && !whiteTurn && toRow == 7) fromPiece.type = PieceType::QUEEN;
+      int promoted = legalMove.promotion_piece();
+      pieceCounts[us][ChessBoard::PAWN]--;
+      pieceCounts[us][promoted]++;
+      material[us] += PIECE_VALUES[promoted] - PIECE_VALUES[ChessBoard::PAWN];
+      materialDirty = true;
+    }
 
     // Perform the move
-    board[toRow][toCol] = fromPiece;
-    board[fromRow][fromCol] = ChessPiece(); // Empty square
-    // isInCheck();
+    board.make_move(legalMove);
+    recordPosition();
+    if (isThreefoldRepetition()) {
+      std::cout << "[GAME] Draw by threefold repetition" << std::endl;
+      drawn = true;
+    } else if (isFiftyMoveRule()) {
+      std::cout << "[GAME] Draw by the 50-move rule" << std::endl;
+      drawn = true;
+    }
  
-    moveHistory.push_back(move);
+    moveHistory.push_back(legalMove);
     if (whiteTurn) {
-      pending_move = move;
+      pending_move = legalMove;
     }
 
     if (!game_actived) timer.startGame();
     timer.switchTurn();
-    
-    // Switch turns
-    whiteTurn = !whiteTurn;
- 
-    // calculate points after move
-    calculatePoints();
-
-    return true;
-}
-
-void ChessGame::handleCastling(int fromRow, int fromCol, int toRow, int toCol) {
-  ChessPiece& fromPiece = board[fromRow][fromCol];
-  // Determine castling direction
-  bool isKingside = (toCol > fromCol);
-  int rookCol = isKingside ? 7 : 0;
-  int direction = isKingside ? 1 : -1;
-
-  // Move the rook
-  if (isKingside) {
-    board[toRow][toCol - 1] = board[fromRow][toCol+1];  // move rook king side
-    board[fromRow][toCol + 1] = ChessPiece();
-  } else {
-    board[toRow][toCol + 1] = board[fromRow][toCol - 2];  // move rook queen side
-    board[fromRow][toCol - 2] = ChessPiece();
-  }
+    // The game is over, nobody can move and the clocks stop
+    if (drawn) timer.pauseGame();
 }
 
 void ChessGame::resetGame() {
@@ -532,9 +348,8 @@ void ChessGame::resetGame() {
     game_actived = false;
     whiteCapturedPieces.clear();
     blackCapturedPieces.clear();
+    pointsWhite = 0;
+    pointsBlack = 0;
     initializeBoard();
     moveHistory.clear();
-    whiteTurn = true;
-    calculatePoints();
 }
-
@@ -5,18 +5,36 @@
 #include "engine/bitboard.h"
 #include "chess_pieces.h"
 #include "chess_timer.h"
+#include <array>
 #include <string>
 #include <vector>
 #include <ctime>
 
 class ChessGame {
 private:
-    ChessPiece board[8][8];
-    std::vector<std::string> moveHistory;
-    bool whiteTurn, fenMode;
+    ChessBoard board;  // Single source of truth for the position
+    std::vector<Move> moveHistory;
+    bool fenMode = false;
+    bool drawn = false;  // Threefold repetition or 50-move rule, no more moves are played
     int pointsWhite = 0;
     int pointsBlack = 0;
 
+    // Material on the board, kept in step with captures and promotions
+    int pieceCounts[2][6] = {};  // [ChessBoard::Color][ChessBoard::Piece]
+    int material[2] = {};
+    bool materialDirty = true;   // Captures, points or material changed since last clear
+
+    // Position key and halfmove clock of every ply, the newest at historyPly - 1.
+    // Repetitions only reach back to the last capture or pawn move, and the
+    // 50-move rule ends the game 100 plies after it, so 256 entries always suffice.
+    struct PlyRecord {
+        uint64_t key;
+        uint16_t halfmoveClock;
+    };
+    static constexpr int HISTORY_RING_SIZE = 256;
+    std::array<PlyRecord, HISTORY_RING_SIZE> positionHistory = {};
+    int historyPly = 0;          // Plies recorded, the ring slot is historyPly % HISTORY_RING_SIZE
+
     // player timers
     bool game_actived = false;
     ChessTimer timer;
@@ -25,19 +43,23 @@ private:
     std::vector<ChessPiece> whiteCapturedPieces;
     std::vector<ChessPiece> blackCapturedPieces;
  
-    void clearBoard();
     void loadCapturedPieces();
-    void calculatePoints(); 
+    void countMaterial();
+    void recordPosition();
+    Move findLegalMove(int fromRow, int fromCol, int toRow, int toCol) const;
+    void applyMove(Move legalMove);
 
 public:
     ChessGame();
     
     // Game state access
-    const ChessPiece& getPiece(int row, int col) const;
+    ChessPiece getPiece(int row, int col) const;
     bool isWhiteTurn() const;
     bool isFenMode() const;
-    const std::vector<std::string>& getMoveHistory() const;
-    std::string pending_move = "";
+    const std::vector<Move>& getMoveHistory() const;
+    Move pending_move;  // User move the engine has to answer, null after loading a FEN
+    bool isEngineTurn() const { return !isWhiteTurn() && !drawn; }
+    bool isDrawn() const { return drawn; }
     
     // Get captured pieces
     const std::vector<ChessPiece>& getWhiteCapturedPieces() const { return whiteCapturedPieces; }
@@ -45,6 +67,18 @@ public:
     int getPointsWhite() const { return pointsWhite; }
     int getPointsBlack() const { return pointsBlack; }
 
+    // Material, O(1) queries
+    int getPieceCount(ChessBoard::Color color, ChessBoard::Piece piece) const { return pieceCounts[color][piece]; }
+    int getMaterial(ChessBoard::Color color) const { return material[color]; }
+    int getMaterialBalance() const { return material[ChessBoard::WHITE] - material[ChessBoard::BLACK]; }
+    bool isMaterialDirty() const { return materialDirty; }
+    void clearMaterialDirty() { materialDirty = false; }
+
+    // Draw rules, scanning back only to the last capture or pawn move
+    int getRepetitionCount() const;
+    bool isThreefoldRepetition() const { return getRepetitionCount() >= 3; }
+    bool isFiftyMoveRule() const { return board.get_halfmove_clock() >= 100; }
+
     // Timers
     std::string getWhiteTimer() { return timer.getWhiteTimer(); }
     std::string getBlackTimer() { return timer.getBlackTimer(); }
@@ -53,15 +87,21 @@ public:
     // Coordinate conversion
     std::string toChessNotation(int row, int col) const;
     bool fromChessNotation(const std::string& notation, int& row, int& col) const;
-    bool fromChessMoveNotation(const std::string& moveNotation, int& fromRow, int& fromCol, int& toRow, int& toCol) const;
+    void getMoveSquares(Move move, int& fromRow, int& fromCol, int& toRow, int& toCol) const;
     
     // Game logic
     void initializeBoard(const std::string& fen = "");
     bool isValidMove(bool& isCastling, int fromRow, int fromCol, int toRow, int toCol) const;
+    ChessBoard::Bitboard getLegalDestinations(int row, int col) const;
+    static bool isDestination(ChessBoard::Bitboard destinations, int row, int col);
+    void classifyDestinations(int row, int col, ChessBoard::Bitboard& losing, ChessBoard::Bitboard& winning) const;
+    ChessBoard::Bitboard getHangingPieces() const;
+    uint64_t getPositionKey() const { return board.get_hash(); }
+    const ChessBoard& getBoard() const { return board; }
     bool isInCheck(int& kingRow, int& kingCol) const;
     bool would_move_leave_king_in_check(int fromRow, int fromCol, int toRow, int toCol) const;
-    void handleCastling(int fromRow, int fromCol, int toRow, int toCol);
     bool movePiece(int fromRow, int fromCol, int toRow, int toCol);
+    bool playMove(Move move);
     void resetGame();
     std::string boardToFEN() const;
 };
@@ -8,6 +8,8 @@
 #include "modal_about.h"
 #include "modal_help.h"
 
+#include <atomic>
+#include <cstdio>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -16,6 +18,10 @@
 #include "chess_pieces.h"
 #include "chess_pieces_sdl.h"
 #include "engine/uci_engine.h"
+#include "engine/engine_supervisor.h"
+#include "engine/search_engine.h"
+#include "engine/polyglot_book.h"
+#include "engine/syzygy_tablebase.h"
 #include "config_manager.h"
 #include "game_state_manager.h"
 
@@ -23,6 +29,11 @@
 bool pieceSelected = false;
 uint8_t selectedRow = -1;
 uint8_t selectedCol = -1;
+ChessBoard::Bitboard selectedTargets = 0;  // Legal destinations of the selected piece
+ChessBoard::Bitboard losingTargets = 0;    // Destinations that hang the selected piece
+ChessBoard::Bitboard winningTargets = 0;   // Captures that win material
+ChessBoard::Bitboard hangingPieces = 0;    // User pieces the engine can win
+uint64_t hangingKey = 0;                   // Position hangingPieces was computed for
 uint8_t lastMoveStartRow = -1;  // Last black move
 uint8_t lastMoveStartCol = -1;
 uint8_t lastMoveEndRow = -1;
@@ -32,7 +43,12 @@ uint8_t lastCheckCol = -1;
 uint8_t cursorRow = 6;   // Cursor position for keyboard navigation
 uint8_t cursorCol = 4;   // Cursor position for keyboard navigation
 bool mouseUsed = false;  // Flag for deselect cursor if Mouse is used
-UCIEngine engine;
+EngineSupervisor engine;                // gnuchess with a warm standby for crashes and new games
+SearchEngine* builtinEngine = nullptr;  // Created on first use
+bool uciEngineReady = false;            // gnuchess answered the UCI handshake
+bool uciEngineTried = false;            // Only try to launch gnuchess once
+PolyglotBook openingBook;               // Optional, set with book_path in config.yml
+SyzygyTablebase tablebases;             // Optional, set with syzygy_path in config.yml
  
 // Settings modal
 SettingsModal* settingsModal = nullptr;
@@ -44,9 +60,35 @@ AboutModal* aboutModal = nullptr;
 GameStateManager* stateManager = nullptr;
 
 std::string pending_fen;
-std::string pending_engine_move = "";
+std::atomic<Move> pending_engine_move{Move()};
 bool isEngineProcessing = false;
 
+// Built-in engine when selected in settings, or as fallback when gnuchess is not available
+bool useBuiltinEngine() {
+  return settingsModal->getSettings().builtinEngine || !uciEngineReady;
+}
+
+void startBuiltinEngine() {
+  if (builtinEngine) return;
+  builtinEngine = new SearchEngine();
+  builtinEngine->setDifficult(settingsModal->getSettings().depthDifficulty);
+  builtinEngine->setMoveTime(settingsModal->getSettings().maxTimePerMove);
+  std::cout << "[SDLG] Built-in engine is ready!" << std::endl;
+}
+
+void startUciEngine() {
+  if (uciEngineReady || uciEngineTried) return;
+  uciEngineTried = true;
+  // Settings first, the supervisor applies them to every engine it starts
+  engine.setPonder(settingsModal->getSettings().ponder);
+  engine.setDifficult(settingsModal->getSettings().depthDifficulty);
+  engine.setMoveTime(settingsModal->getSettings().maxTimePerMove);
+  if (engine.start()) {
+    std::cout << "[SDLG] Engine is ready!" << std::endl;
+    uciEngineReady = true;
+  }
+}
+
 void resetBoard(ChessGame& chessGame) {
   chessGame.resetGame();
   pieceSelected = false;
@@ -60,16 +102,40 @@ void resetBoard(ChessGame& chessGame) {
   lastMoveEndCol = -1;
   lastCheckCol = -1;
   lastCheckRow = -1;
-  chessGame.pending_move.clear();
+  chessGame.pending_move = Move();
   gameInfoModal->setBlackTimer(chessGame.getBlackTimer());
   gameInfoModal->setWhiteTimer(chessGame.getWhiteTimer());
-  engine.newGame();
+  gameInfoModal->setEngineInfo("");
+  if (builtinEngine) builtinEngine->newGame();
+  if (uciEngineReady) engine.newGame();
+  // The engines drop a search of the old game, nothing is coming for it
+  isEngineProcessing = false;
+  pending_engine_move = Move();
+  if (!uciEngineReady) return;
   if (settingsModal->getSettings().depthDifficulty <= 2) {
     engine.sendCommand("easy");
     engine.sendCommand("random");
   }
 }
 
+void selectTargets(ChessGame& chessGame, int row, int col) {
+  selectedTargets = chessGame.getLegalDestinations(row, col);
+  chessGame.classifyDestinations(row, col, losingTargets, winningTargets);
+}
+
+// "Depth 12  Eval -0.35  850 knps", eval from White's side since the engine plays Black
+void updateEngineInfo(const SearchInfo& info) {
+  int score = -info.score;
+  char eval[16];
+  if (info.mate) snprintf(eval, sizeof(eval), "M%d", score);
+  else snprintf(eval, sizeof(eval), "%+.2f", score / 100.0);
+
+  char text[64];
+  snprintf(text, sizeof(text), "Depth %d  Eval %s  %llu knps", info.depth, eval,
+           static_cast<unsigned long long>(info.nps / 1000));
+  gameInfoModal->setEngineInfo(text);
+}
+
 void updateInfoModal(ChessGame& chessGame) {
 // Show game info modal
   if (gameInfoModal) {
@@ -78,10 +144,12 @@ void updateInfoModal(ChessGame& chessGame) {
       chessGame.getBlackCapturedPieces()
     );
 
-    bool negative = chessGame.getPointsWhite() - chessGame.getPointsBlack() < 0;
-    int pointsDiff = abs(chessGame.getPointsWhite() - chessGame.getPointsBlack());
-    gameInfoModal->setPoints((negative ? "-" : "+") + std::to_string(pointsDiff), negative);  
+    // Material balance, so promotions count as well as captures
+    int balance = chessGame.getMaterialBalance();
+    bool negative = balance < 0;
+    gameInfoModal->setPoints((negative ? "-" : "+") + std::to_string(abs(balance)), negative);  
   }
+  chessGame.clearMaterialDirty();
 }
 
 // Handle keyboard input for piece selection and movement
@@ -109,6 +177,7 @@ void handleKeyboardInput(SDL_Keycode key, ChessGame& chessGame) {
                                  (!chessGame.isWhiteTurn() && piece.color == PieceColor::BLACK))) {
           selectedRow = cursorRow;
           selectedCol = cursorCol;
+          selectTargets(chessGame, cursorRow, cursorCol);
           pieceSelected = true;
         }
       } else {
@@ -120,7 +189,7 @@ void handleKeyboardInput(SDL_Keycode key, ChessGame& chessGame) {
       break;
     case SDLK_RETURN:
       // Move selected piece to cursor position
-      if (pieceSelected) {
+      if (pieceSelected && ChessGame::isDestination(selectedTargets, cursorRow, cursorCol)) {
         if (chessGame.movePiece(selectedRow, selectedCol, cursorRow, cursorCol)) {
           // Move successful
           pieceSelected = false;
@@ -198,11 +267,12 @@ void handleMouseClick(int mouseX, int mouseY, ChessGame& chessGame) {
                                (!chessGame.isWhiteTurn() && piece.color == PieceColor::BLACK))) {
         selectedRow = row;
         selectedCol = col;
+        selectTargets(chessGame, row, col);
         pieceSelected = true;
       }
     } else {
-      // Move selected piece
-      if (chessGame.movePiece(selectedRow, selectedCol, row, col)) {
+      // Move selected piece, clicks outside its legal destinations are rejected up front
+      if (ChessGame::isDestination(selectedTargets, row, col) && chessGame.movePiece(selectedRow, selectedCol, row, col)) {
         // Move successful - clear selection
         pieceSelected = false;
         selectedRow = -1;
@@ -215,6 +285,7 @@ void handleMouseClick(int mouseX, int mouseY, ChessGame& chessGame) {
           // Select the new piece
           selectedRow = row;
           selectedCol = col;
+          selectTargets(chessGame, row, col);
         } else {
           // Deselect if clicking on empty square or opponent piece
           pieceSelected = false;
@@ -226,11 +297,13 @@ void handleMouseClick(int mouseX, int mouseY, ChessGame& chessGame) {
   }
 }
 
-void process_engine_move(ChessGame& chessGame, std::string& engine_move) {
-  engine.addMoveToHistory(engine_move);
+void process_engine_move(ChessGame& chessGame, Move engine_move) {
+  // A loaded position is sent whole every turn: gnuchess keeps no history
+  // for it, so it never ponders on a game that did not start from startpos
+  if (!chessGame.isFenMode()) engine.addMoveToHistory(engine_move);
   int fromRow, fromCol, toRow, toCol;
-  chessGame.fromChessMoveNotation(engine_move, fromRow, fromCol, toRow, toCol);
-  chessGame.movePiece(fromRow, fromCol, toRow, toCol);
+  chessGame.getMoveSquares(engine_move, fromRow, fromCol, toRow, toCol);
+  chessGame.playMove(engine_move);
   lastMoveStartRow = fromRow;
   lastMoveStartCol = fromCol;
   lastMoveEndRow = toRow;
@@ -241,14 +314,16 @@ void process_engine_move(ChessGame& chessGame, std::string& engine_move) {
     lastCheckCol = checkCol;  // Notify to user check position
     lastCheckRow = checkRow;
   }
-  chessGame.pending_move.clear();
-  engine_move.clear();
+  chessGame.pending_move = Move();
   isEngineProcessing = false;
   std::cout << "[SDLG] FEN: \"" << chessGame.boardToFEN() << "\"" << std::endl;
 }
 
-UCIEngine::MoveCallback  cbOnEngineMove([](const std::string& move) {
-    std::cout << "[SDLG] engine move callback received: " << move << std::endl;
+UCIEngine::MoveCallback  cbOnEngineMove([](Move move) {
+    char uci[6];
+    move.to_uci(uci);
+    std::cout << "[SDLG] engine move callback received: " << uci << std::endl;
+    if (move.is_null()) return;  // no legal reply, the game is over
     pending_engine_move = move;
 });
 
@@ -321,9 +396,9 @@ void mainLoop(ChessGame& chessGame, SDL_Renderer* renderer) {
           lastCheckRow = -1;
         }
         // Highlight cursor position
-        else if (row == cursorRow && col == cursorCol && !mouseUsed && !chessGame.pending_move.empty()) { 
+        else if (row == cursorRow && col == cursorCol && !mouseUsed && chessGame.isEngineTurn()) { 
           SDL_SetRenderDrawColor(renderer, 172, 83, 83, 255);  // Red light for cursor
-        } else if (row == cursorRow && col == cursorCol && !mouseUsed && chessGame.pending_move.empty()) {
+        } else if (row == cursorRow && col == cursorCol && !mouseUsed && !chessGame.isEngineTurn()) {
           SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);  // Yellow for cursor 
         } else if (row == lastMoveStartRow && col == lastMoveStartCol) {
           SDL_SetRenderDrawColor(renderer, 153, 153, 153, 255);  // Last opponent move Start
@@ -352,13 +427,55 @@ void mainLoop(ChessGame& chessGame, SDL_Renderer* renderer) {
         }
       }
     }
+
+    // Frame the user pieces that are hanging, refreshed only when the position changes
+    if (chessGame.getPositionKey() != hangingKey) {
+      hangingKey = chessGame.getPositionKey();
+      hangingPieces = chessGame.isWhiteTurn() ? chessGame.getHangingPieces() : 0;
+    }
+    if (hangingPieces) {
+      SDL_SetRenderDrawColor(renderer, 220, 0, 0, 255);  // Red frame
+      for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+          if (!ChessGame::isDestination(hangingPieces, row, col)) continue;
+          SDL_Rect frame = {col * SQUARE_SIZE, row * SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE};
+          SDL_RenderDrawRect(renderer, &frame);
+          SDL_Rect inner = {frame.x + 1, frame.y + 1, SQUARE_SIZE - 2, SQUARE_SIZE - 2};
+          SDL_RenderDrawRect(renderer, &inner);
+        }
+      }
+    }
+
+    // Draw move targets of the selected piece
+    if (pieceSelected) {
+      SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+      for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+          if (!ChessGame::isDestination(selectedTargets, row, col)) continue;
+          if (ChessGame::isDestination(losingTargets, row, col)) {
+            SDL_SetRenderDrawColor(renderer, 200, 0, 0, 180);    // Translucent red, hangs the piece
+          } else if (ChessGame::isDestination(winningTargets, row, col)) {
+            SDL_SetRenderDrawColor(renderer, 230, 180, 0, 180);  // Translucent gold, wins material
+          } else {
+            SDL_SetRenderDrawColor(renderer, 0, 160, 0, 160);    // Translucent green
+          }
+          SDL_Rect target = {col * SQUARE_SIZE + SQUARE_SIZE * 3 / 8, row * SQUARE_SIZE + SQUARE_SIZE * 3 / 8,
+                             SQUARE_SIZE / 4, SQUARE_SIZE / 4};
+          SDL_RenderFillRect(renderer, &target);
+        }
+      }
+    }
     
     if (chessGame.isWhiteTurn())
       gameInfoModal->setWhiteTimer(chessGame.getWhiteTimer());
     else
       gameInfoModal->setBlackTimer(chessGame.getBlackTimer());
 
-    updateInfoModal(chessGame); 
+    // Only rebuild the captured pieces and points when material changed
+    if (chessGame.isMaterialDirty()) updateInfoModal(chessGame);
+
+    SearchInfo searchInfo;
+    if (engine.getSearchInfo(searchInfo)) updateEngineInfo(searchInfo);
 
     // Render modal windows
     settingsModal->render();
@@ -371,14 +488,37 @@ void mainLoop(ChessGame& chessGame, SDL_Renderer* renderer) {
     SDL_RenderPresent(renderer);
 
     // Send move to engine and update its move
-    if (!chessGame.pending_move.empty() && !isEngineProcessing) {  
-      std::cout << "[SDLG] sending move  : " << chessGame.pending_move << std::endl;
+    if (chessGame.isEngineTurn() && !isEngineProcessing) {  
+      char uci[6];
+      chessGame.pending_move.to_uci(uci);
+      std::cout << "[SDLG] sending move  : " << uci << std::endl;
       
       isEngineProcessing = true; 
+      Move instantMove;
      
-      if (chessGame.isFenMode()) {
+      if (openingBook.probe(chessGame.getBoard(), instantMove)) {
+        // Keep the gnuchess history in step, it never sees this move
+        instantMove.to_uci(uci);
+        std::cout << "[BOOK] book move: " << uci << std::endl;
+        if (!chessGame.isFenMode()) engine.addMoveToHistory(chessGame.pending_move);
+        cbOnEngineMove(instantMove);
+      }
+
+      else if (tablebases.probeRoot(chessGame.getBoard(), instantMove)) {
+        // Exact endgame answer, no search needed
+        if (!chessGame.isFenMode()) engine.addMoveToHistory(chessGame.pending_move);
+        cbOnEngineMove(instantMove);
+      }
+
+      else if (useBuiltinEngine()) {
+        // Always the full position so switching engines mid-game keeps both in step
+        if (!chessGame.isFenMode()) engine.addMoveToHistory(chessGame.pending_move);
+        builtinEngine->sendPositionAsync(chessGame.getBoard(), cbOnEngineMove);
+      }
+
+      else if (chessGame.isFenMode()) {
         // engine_move = engine.sendMove(chessGame.boardToFEN());
-        engine.sendMoveAsync(chessGame.boardToFEN(),cbOnEngineMove);
+        engine.sendPositionAsync(chessGame.boardToFEN(),cbOnEngineMove);
       }
         
       else {
@@ -387,8 +527,9 @@ void mainLoop(ChessGame& chessGame, SDL_Renderer* renderer) {
       }
     }
 
-    if (!pending_engine_move.empty()) {
-      process_engine_move(chessGame, pending_engine_move);
+    Move engineMove = pending_engine_move.exchange(Move());
+    if (!engineMove.is_null()) {
+      process_engine_move(chessGame, engineMove);
     }
 
     // Frame rate limiting
@@ -458,8 +599,18 @@ void renderChessboardSDL(std::string fen) {
     std::cout << "[SDLG]   Max Time Per Move: " << settings.maxTimePerMove << std::endl;
     std::cout << "[SDLG]   Match Time: " << settings.matchTime << std::endl;
 
+    std::cout << "[SDLG]   Built-in Engine: " << (settings.builtinEngine ? "Enabled" : "Disabled") << std::endl;
+
+    if (settings.builtinEngine) startBuiltinEngine();
+    else startUciEngine();
+    if (!uciEngineReady) startBuiltinEngine();
+
     engine.setDifficult(settingsModal->getSettings().depthDifficulty); 
     engine.setMoveTime(settingsModal->getSettings().maxTimePerMove);
+    if (builtinEngine) {
+      builtinEngine->setDifficult(settingsModal->getSettings().depthDifficulty);
+      builtinEngine->setMoveTime(settingsModal->getSettings().maxTimePerMove);
+    }
     chessGame.setTimeMatch(settingsModal->getSettings().matchTime);
     gameInfoModal->setBlackTimer(chessGame.getBlackTimer());
     gameInfoModal->setWhiteTimer(chessGame.getWhiteTimer());
@@ -469,22 +620,18 @@ void renderChessboardSDL(std::string fen) {
   gameInfoModal->setBlackTimer(chessGame.getBlackTimer());
   gameInfoModal->setWhiteTimer(chessGame.getWhiteTimer());
 
-  // Initialize engine - debug disabled
-  if (engine.startEngine(false)) {
-    // Initialize UCI protocol
-    engine.sendCommand("uci");
-    if (engine.waitForResponse("uciok")) {
-      std::cout << "[SDLG] Engine is UCI compatible!" << std::endl;
-    }
-    engine.sendCommand("isready");
-    if (engine.waitForResponse("readyok")) {
-      std::cout << "[SDLG] Engine is ready!" << std::endl;
-      engine.setDifficult(settingsModal->getSettings().depthDifficulty);
-      engine.setMoveTime(settingsModal->getSettings().maxTimePerMove);
+  // Initialize engine - gnuchess unless the built-in one is selected
+  if (!settingsModal->getSettings().builtinEngine) startUciEngine();
+  if (!uciEngineReady) {
+    if (!settingsModal->getSettings().builtinEngine) {
+      std::cout << "[SDLG] gnuchess not available, using the built-in engine" << std::endl;
     }
-    resetBoard(chessGame);
-    chessGame.initializeBoard(fen);
+    startBuiltinEngine();
   }
+  if (!settingsModal->getSettings().bookPath.empty()) openingBook.open(settingsModal->getSettings().bookPath);
+  if (!settingsModal->getSettings().syzygyPath.empty()) tablebases.init(settingsModal->getSettings().syzygyPath);
+  resetBoard(chessGame);
+  chessGame.initializeBoard(fen);
 
   // Set game state selection callback
   gameStatesModal->setOnStateSelected([&chessGame](const std::string& sfen) {
@@ -500,6 +647,7 @@ void renderChessboardSDL(std::string fen) {
   delete gameInfoModal;
   delete helpModal;
   delete aboutModal;
+  delete builtinEngine;
 
   cleanupChessPieceTextures();
   SDL_DestroyRenderer(renderer);
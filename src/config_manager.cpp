@@ -84,6 +84,10 @@ YAML::Node ConfigManager::settingsToYaml(const Settings& settings) {
     node["max_time_per_move"] = settings.maxTimePerMove;
     node["match_time"] = settings.matchTime;
     node["sound_enabled"] = settings.soundEnabled;
+    node["builtin_engine"] = settings.builtinEngine;
+    node["ponder"] = settings.ponder;
+    node["book_path"] = settings.bookPath;
+    node["syzygy_path"] = settings.syzygyPath;
     
     return node;
 }
@@ -106,6 +110,22 @@ ConfigManager::Settings ConfigManager::yamlToSettings(const YAML::Node& node) {
     if (node["sound_enabled"]) {
         settings.soundEnabled = node["sound_enabled"].as<bool>();
     }
+
+    if (node["builtin_engine"]) {
+        settings.builtinEngine = node["builtin_engine"].as<bool>();
+    }
+
+    if (node["ponder"]) {
+        settings.ponder = node["ponder"].as<bool>();
+    }
+
+    if (node["book_path"]) {
+        settings.bookPath = node["book_path"].as<std::string>();
+    }
+
+    if (node["syzygy_path"]) {
+        settings.syzygyPath = node["syzygy_path"].as<std::string>();
+    }
     
     return settings;
 }
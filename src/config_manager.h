@@ -13,6 +13,10 @@ public:
         int maxTimePerMove = 2;       // seconds (0-300)
         int matchTime = 10;           // minutes (0-60)
         bool soundEnabled = false;
+        bool builtinEngine = false;   // in-process engine instead of gnuchess
+        bool ponder = true;           // gnuchess thinks on the user's time
+        std::string bookPath;         // Polyglot opening book, empty to disable
+        std::string syzygyPath;       // Syzygy tablebase directories separated by ':'
     };
 
     ConfigManager();
@@ -1,95 +1,346 @@
 #include "bitboard.h"
 
-void ChessBoard::initialize_attack_tables() {
-  // Knight moves (8 possible directions)
-  int knight_dx[] = {2, 2, 1, 1, -1, -1, -2, -2};
-  int knight_dy[] = {1, -1, 2, -2, 2, -2, 1, -1};
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+// PEXT is opt-in through the CHESS_USE_PEXT build option, never picked up
+// from -march=native: it is microcoded and slower than the magic multiply
+// on AMD before Zen 3. Such a build still runs without BMI2, on magics
+#if defined(CHESS_USE_PEXT)
+#include <immintrin.h>
+#endif
 
-  // King moves (8 directions)
-  int king_dx[] = {1, 1, 1, 0, 0, -1, -1, -1};
-  int king_dy[] = {1, 0, -1, 1, -1, 1, 0, -1};
+// =========================================================================
+// ATTACK TABLES - Generated at compile time, shared read-only by every board
+// =========================================================================
 
-  // Pawn attacks (captures)
-  int white_pawn_dx[] = {1, 1};
-  int white_pawn_dy[] = {-1, 1};
-  int black_pawn_dx[] = {-1, -1};
-  int black_pawn_dy[] = {-1, 1};
+namespace {
 
+constexpr int KNIGHT_DELTAS[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+constexpr int KING_DELTAS[8][2] = {{1, 1}, {1, 0}, {1, -1}, {0, 1}, {0, -1}, {-1, 1}, {-1, 0}, {-1, -1}};
+constexpr int WHITE_PAWN_DELTAS[2][2] = {{-1, 1}, {1, 1}};
+constexpr int BLACK_PAWN_DELTAS[2][2] = {{-1, -1}, {1, -1}};
+constexpr int ROOK_DIRECTIONS[4][2] = {{0, 1}, {1, 0}, {0, -1}, {-1, 0}};
+constexpr int BISHOP_DIRECTIONS[4][2] = {{1, 1}, {1, -1}, {-1, -1}, {-1, 1}};
+
+/**
+ * Build a table of single-step targets (knight, king, pawn captures)
+ * @param deltas: (file, rank) offsets reachable from each square
+ */
+template <std::size_t N>
+constexpr std::array<uint64_t, 64> leaper_table(const int (&deltas)[N][2]) {
+  std::array<uint64_t, 64> table{};
   for (int square = 0; square < 64; ++square) {
     int x = square % 8;
     int y = square / 8;
-
-    // Initialize knight attacks
-    knight_attacks[square] = 0;
-    for (int i = 0; i < 8; ++i) {
-      int new_x = x + knight_dx[i];
-      int new_y = y + knight_dy[i];
+    for (std::size_t i = 0; i < N; ++i) {
+      int new_x = x + deltas[i][0];
+      int new_y = y + deltas[i][1];
       if (new_x >= 0 && new_x < 8 && new_y >= 0 && new_y < 8) {
-        knight_attacks[square] |= 1ULL << (new_y * 8 + new_x);
+        table[square] |= 1ULL << (new_y * 8 + new_x);
       }
     }
+  }
+  return table;
+}
 
-    // Initialize king attacks
-    king_attacks[square] = 0;
-    for (int i = 0; i < 8; ++i) {
-      int new_x = x + king_dx[i];
-      int new_y = y + king_dy[i];
-      if (new_x >= 0 && new_x < 8 && new_y >= 0 && new_y < 8) {
-        king_attacks[square] |= 1ULL << (new_y * 8 + new_x);
+/**
+ * Build a table of full rays on an empty board (rook or bishop)
+ * @param directions: (file, rank) step of each ray
+ */
+constexpr std::array<uint64_t, 64> ray_table(const int (&directions)[4][2]) {
+  std::array<uint64_t, 64> table{};
+  for (int square = 0; square < 64; ++square) {
+    for (int dir = 0; dir < 4; ++dir) {
+      int new_x = square % 8 + directions[dir][0];
+      int new_y = square / 8 + directions[dir][1];
+      while (new_x >= 0 && new_x < 8 && new_y >= 0 && new_y < 8) {
+        table[square] |= 1ULL << (new_y * 8 + new_x);
+        new_x += directions[dir][0];
+        new_y += directions[dir][1];
       }
     }
+  }
+  return table;
+}
 
-    // Initialize pawn attacks
-    pawn_attacks[ChessBoard::WHITE][square] = 0;
-    for (int i = 0; i < 2; ++i) {
-      int new_x = x + white_pawn_dy[i];  // Note: swapped for little-endian
-      int new_y = y + white_pawn_dx[i];
-      if (new_x >= 0 && new_x < 8 && new_y >= 0 && new_y < 8) {
-        pawn_attacks[ChessBoard::WHITE][square] |= 1ULL << (new_y * 8 + new_x);
+constexpr std::array<uint64_t, 64> KNIGHT_ATTACKS = leaper_table(KNIGHT_DELTAS);
+constexpr std::array<uint64_t, 64> KING_ATTACKS = leaper_table(KING_DELTAS);
+constexpr std::array<std::array<uint64_t, 64>, 2> PAWN_ATTACKS = {leaper_table(WHITE_PAWN_DELTAS),
+                                                                  leaper_table(BLACK_PAWN_DELTAS)};
+constexpr std::array<uint64_t, 64> ROOK_RAYS = ray_table(ROOK_DIRECTIONS);
+constexpr std::array<uint64_t, 64> BISHOP_RAYS = ray_table(BISHOP_DIRECTIONS);
+
+/**
+ * Build the BETWEEN or LINE table for every pair of aligned squares
+ * @param full_line: false for squares strictly between a and b,
+ *                   true for the whole edge-to-edge line through both
+ */
+constexpr std::array<std::array<uint64_t, 64>, 64> alignment_table(bool full_line) {
+  std::array<std::array<uint64_t, 64>, 64> table{};
+  const int(*families[2])[2] = {ROOK_DIRECTIONS, BISHOP_DIRECTIONS};
+  for (int square = 0; square < 64; ++square) {
+    for (const auto directions : families) {
+      for (int dir = 0; dir < 4; ++dir) {
+        // The opposite direction sits two entries further in both tables
+        int back = (dir + 2) % 4;
+        uint64_t line = 1ULL << square;
+        for (int d : {dir, back}) {
+          int new_x = square % 8 + directions[d][0];
+          int new_y = square / 8 + directions[d][1];
+          while (new_x >= 0 && new_x < 8 && new_y >= 0 && new_y < 8) {
+            line |= 1ULL << (new_y * 8 + new_x);
+            new_x += directions[d][0];
+            new_y += directions[d][1];
+          }
+        }
+
+        uint64_t path = 0;
+        int new_x = square % 8 + directions[dir][0];
+        int new_y = square / 8 + directions[dir][1];
+        while (new_x >= 0 && new_x < 8 && new_y >= 0 && new_y < 8) {
+          int target = new_y * 8 + new_x;
+          table[square][target] = full_line ? line : path;
+          path |= 1ULL << target;
+          new_x += directions[dir][0];
+          new_y += directions[dir][1];
+        }
       }
     }
+  }
+  return table;
+}
 
-    pawn_attacks[ChessBoard::BLACK][square] = 0;
-    for (int i = 0; i < 2; ++i) {
-      int new_x = x + black_pawn_dy[i];
-      int new_y = y + black_pawn_dx[i];
-      if (new_x >= 0 && new_x < 8 && new_y >= 0 && new_y < 8) {
-        pawn_attacks[ChessBoard::BLACK][square] |= 1ULL << (new_y * 8 + new_x);
-      }
+constexpr std::array<std::array<uint64_t, 64>, 64> BETWEEN = alignment_table(false);
+constexpr std::array<std::array<uint64_t, 64>, 64> LINE = alignment_table(true);
+
+// Zobrist keys, derived at compile time from a fixed splitmix64 stream
+struct ZobristKeys {
+  uint64_t pieces[2][6][64];  // [color][piece][square]
+  uint64_t castling[16];      // indexed by the 4-bit castling rights mask
+  uint64_t en_passant_file[8];
+  uint64_t side;              // xor-ed in when black is to move
+};
+
+constexpr uint64_t splitmix64(uint64_t& state) {
+  uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys zobrist_keys() {
+  ZobristKeys keys{};
+  uint64_t state = 0x43686573734B6579ULL;
+  for (auto& color : keys.pieces)
+    for (auto& piece : color)
+      for (auto& square : piece) square = splitmix64(state);
+  // One key per right, each mask entry is the xor of the rights it holds
+  uint64_t rights[4] = {splitmix64(state), splitmix64(state), splitmix64(state), splitmix64(state)};
+  for (int mask = 0; mask < 16; ++mask) {
+    for (int bit = 0; bit < 4; ++bit) {
+      if (mask & (1 << bit)) keys.castling[mask] ^= rights[bit];
     }
+  }
+  for (auto& file : keys.en_passant_file) file = splitmix64(state);
+  keys.side = splitmix64(state);
+  return keys;
+}
 
-    // Initialize basic sliding piece attacks (simplified - no magic bitboards)
-    rook_attacks_base[square] = 0;
-    bishop_attacks_base[square] = 0;
+constexpr ZobristKeys ZOBRIST = zobrist_keys();
+
+// Castling rights kept after a move touches each square (king and rook homes)
+constexpr std::array<uint8_t, 64> castling_mask_table() {
+  std::array<uint8_t, 64> table{};
+  for (auto& mask : table) mask = 0x0F;
+  table[4] = 0x0C;   // e1: white loses both
+  table[7] = 0x0E;   // h1: white kingside
+  table[0] = 0x0D;   // a1: white queenside
+  table[60] = 0x03;  // e8: black loses both
+  table[63] = 0x0B;  // h8: black kingside
+  table[56] = 0x07;  // a8: black queenside
+  return table;
+}
 
-    // Rook: horizontal and vertical
-    for (int dir = 0; dir < 4; ++dir) {
-      int dx = (dir == 1) ? 1 : (dir == 3) ? -1 : 0;
-      int dy = (dir == 0) ? 1 : (dir == 2) ? -1 : 0;
+constexpr std::array<uint8_t, 64> CASTLING_MASK = castling_mask_table();
 
-      int new_x = x + dx;
-      int new_y = y + dy;
-      while (new_x >= 0 && new_x < 8 && new_y >= 0 && new_y < 8) {
-        rook_attacks_base[square] |= 1ULL << (new_y * 8 + new_x);
-        new_x += dx;
-        new_y += dy;
-      }
-    }
+// Rook from/to squares of a castling move, as one xor-able bitboard
+constexpr uint64_t castling_rook_hop(int color, bool kingside) {
+  int rank = (color == 0) ? 0 : 56;
+  return kingside ? (1ULL << (7 + rank)) | (1ULL << (5 + rank)) : (1ULL << rank) | (1ULL << (3 + rank));
+}
 
-    // Bishop: diagonals
-    for (int dir = 0; dir < 4; ++dir) {
-      int dx = (dir == 0 || dir == 1) ? 1 : -1;
-      int dy = (dir == 0 || dir == 3) ? 1 : -1;
+constexpr uint64_t RANK_1 = 0xFFULL;
+constexpr uint64_t RANK_8 = 0xFF00000000000000ULL;
 
-      int new_x = x + dx;
-      int new_y = y + dy;
-      while (new_x >= 0 && new_x < 8 && new_y >= 0 && new_y < 8) {
-        bishop_attacks_base[square] |= 1ULL << (new_y * 8 + new_x);
-        new_x += dx;
-        new_y += dy;
-      }
+static_assert(KNIGHT_ATTACKS[0] == 0x20400ULL, "knight table on a1");
+static_assert(KING_ATTACKS[63] == 0x40C0000000000000ULL, "king table on h8");
+static_assert(BETWEEN[0][63] == 0x0040201008040200ULL, "a1-h8 diagonal");
+static_assert(LINE[9][18] == 0x8040201008040201ULL, "b2-c3 line");
+
+// =========================================================================
+// MAGIC BITBOARDS - Slider attacks as a single table lookup
+// =========================================================================
+
+// Per-square magic entry: relevant occupancy mask, multiplier, shift and
+// the slice of the shared attack table owned by this square
+struct Magic {
+  uint64_t mask;
+  uint64_t magic;
+  uint64_t* attacks;
+  unsigned shift;
+
+  unsigned index(uint64_t occupancy) const {
+    return static_cast<unsigned>(((occupancy & mask) * magic) >> shift);
+  }
+
+#if defined(CHESS_USE_PEXT)
+  __attribute__((target("bmi2"))) unsigned pext_index(uint64_t occupancy) const {
+    return static_cast<unsigned>(_pext_u64(occupancy, mask));
+  }
+#endif
+};
+
+#if defined(CHESS_USE_PEXT)
+bool use_pext = false;  // the CPU has BMI2, the tables are laid out by pext_index
+#endif
+
+Magic rook_magics[64];
+Magic bishop_magics[64];
+uint64_t rook_table[0x19000];   // 102400 entries, sum of 2^bits over all squares
+uint64_t bishop_table[0x1480];  // 5248 entries
+std::once_flag magics_once;
+
+// Collision-free multipliers for the masks below, found offline with a
+// sparse random search; fixed here so start-up is only a table fill
+const uint64_t ROOK_MAGICS[64] = {
+    0x0A80004000801220ULL, 0x8040004010002008ULL, 0x2080200010008008ULL, 0x1100100008210004ULL,
+    0xC200209084020008ULL, 0x2100010004000208ULL, 0x0400081000822421ULL, 0x0200010422048844ULL,
+    0x0800800080400024ULL, 0x0001402000401000ULL, 0x3000801000802001ULL, 0x4400800800100083ULL,
+    0x0904802402480080ULL, 0x4040800400020080ULL, 0x0018808042000100ULL, 0x4040800080004100ULL,
+    0x0040048001458024ULL, 0x00A0004000205000ULL, 0x3100808010002000ULL, 0x4825010010000820ULL,
+    0x5004808008000401ULL, 0x2024818004000A00ULL, 0x0005808002000100ULL, 0x2100060004806104ULL,
+    0x0080400880008421ULL, 0x4062220600410280ULL, 0x010A004A00108022ULL, 0x0000100080080080ULL,
+    0x0021000500080010ULL, 0x0044000202001008ULL, 0x0000100400080102ULL, 0xC020128200040545ULL,
+    0x0080002000400040ULL, 0x0000804000802004ULL, 0x0000120022004080ULL, 0x010A386103001001ULL,
+    0x9010080080800400ULL, 0x8440020080800400ULL, 0x0004228824001001ULL, 0x000000490A000084ULL,
+    0x0080002000504000ULL, 0x200020005000C000ULL, 0x0012088020420010ULL, 0x0010010080080800ULL,
+    0x0085001008010004ULL, 0x0002000204008080ULL, 0x0040413002040008ULL, 0x0000304081020004ULL,
+    0x0080204000800080ULL, 0x3008804000290100ULL, 0x1010100080200080ULL, 0x2008100208028080ULL,
+    0x5000850800910100ULL, 0x8402019004680200ULL, 0x0120911028020400ULL, 0x0000008044010200ULL,
+    0x0020850200244012ULL, 0x0020850200244012ULL, 0x0000102001040841ULL, 0x140900040A100021ULL,
+    0x000200282410A102ULL, 0x000200282410A102ULL, 0x000200282410A102ULL, 0x4048240043802106ULL,
+};
+
+const uint64_t BISHOP_MAGICS[64] = {
+    0x40106000A1160020ULL, 0x0020010250810120ULL, 0x2010010220280081ULL, 0x002806004050C040ULL,
+    0x0002021018000000ULL, 0x2001112010000400ULL, 0x0881010120218080ULL, 0x1030820110010500ULL,
+    0x0000120222042400ULL, 0x2000020404040044ULL, 0x8000480094208000ULL, 0x0003422A02000001ULL,
+    0x000A220210100040ULL, 0x8004820202226000ULL, 0x0018234854100800ULL, 0x0100004042101040ULL,
+    0x0004001004082820ULL, 0x0010000810010048ULL, 0x1014004208081300ULL, 0x2080818802044202ULL,
+    0x0040880C00A00100ULL, 0x0080400200522010ULL, 0x0001000188180B04ULL, 0x0080249202020204ULL,
+    0x1004400004100410ULL, 0x00013100A0022206ULL, 0x2148500001040080ULL, 0x4241080011004300ULL,
+    0x4020848004002000ULL, 0x10101380D1004100ULL, 0x0008004422020284ULL, 0x01010A1041008080ULL,
+    0x0808080400082121ULL, 0x0808080400082121ULL, 0x0091128200100C00ULL, 0x0202200802010104ULL,
+    0x8C0A020200440085ULL, 0x01A0008080B10040ULL, 0x0889520080122800ULL, 0x100902022202010AULL,
+    0x04081A0816002000ULL, 0x0000681208005000ULL, 0x8170840041008802ULL, 0x0A00004200810805ULL,
+    0x0830404408210100ULL, 0x2602208106006102ULL, 0x1048300680802628ULL, 0x2602208106006102ULL,
+    0x0602010120110040ULL, 0x0941010801043000ULL, 0x000040440A210428ULL, 0x0008240020880021ULL,
+    0x0400002012048200ULL, 0x00AC102001210220ULL, 0x0220021002009900ULL, 0x84440C080A013080ULL,
+    0x0001008044200440ULL, 0x0004C04410841000ULL, 0x2000500104011130ULL, 0x1A0C010011C20229ULL,
+    0x0044800112202200ULL, 0x0434804908100424ULL, 0x0300404822C08200ULL, 0x48081010008A2A80ULL,
+};
+
+// Slow ray walk, only used to fill the tables at startup
+uint64_t sliding_attacks_slow(int square, uint64_t occupancy, const int (&directions)[4][2]) {
+  uint64_t attacks = 0;
+  for (int dir = 0; dir < 4; ++dir) {
+    int new_x = square % 8 + directions[dir][0];
+    int new_y = square / 8 + directions[dir][1];
+    while (new_x >= 0 && new_x < 8 && new_y >= 0 && new_y < 8) {
+      int current_square = new_y * 8 + new_x;
+      attacks |= 1ULL << current_square;
+      if (occupancy & (1ULL << current_square)) break;
+      new_x += directions[dir][0];
+      new_y += directions[dir][1];
     }
   }
+  return attacks;
+}
+
+/**
+ * Fill the magic entries and attack table for one slider type
+ * @param rays: full rays from every square on an empty board
+ * @param directions: ray steps matching the rays table
+ * @param magic_numbers: multiplier per square (unused with PEXT)
+ * @param magics: receives the entries, the slices are laid out by the index in use
+ */
+void init_magics(const std::array<uint64_t, 64>& rays, const int (&directions)[4][2], const uint64_t magic_numbers[],
+                 Magic magics[], uint64_t table[]) {
+  const uint64_t rank_edges = 0xFF000000000000FFULL;
+  const uint64_t file_edges = 0x8181818181818181ULL;
+  uint64_t* slice = table;
+
+  for (int square = 0; square < 64; ++square) {
+    // Board edges never block a ray, unless the slider itself stands on them
+    uint64_t rank_mask = 0xFFULL << (8 * (square / 8));
+    uint64_t file_mask = 0x0101010101010101ULL << (square % 8);
+    uint64_t edges = (rank_edges & ~rank_mask) | (file_edges & ~file_mask);
+
+    Magic& m = magics[square];
+    m.mask = rays[square] & ~edges;
+    m.magic = magic_numbers[square];
+    m.shift = 64 - __builtin_popcountll(m.mask);
+    m.attacks = slice;
+
+    // Carry-rippler enumeration of every subset of the relevant mask
+    uint64_t subset = 0;
+    do {
+#if defined(CHESS_USE_PEXT)
+      unsigned index = use_pext ? m.pext_index(subset) : m.index(subset);
+#else
+      unsigned index = m.index(subset);
+#endif
+      m.attacks[index] = sliding_attacks_slow(square, subset, directions);
+      subset = (subset - m.mask) & m.mask;
+    } while (subset);
+    slice += 1ULL << __builtin_popcountll(m.mask);
+  }
+}
+
+#if defined(CHESS_USE_PEXT)
+// Whole lookup in one BMI2 function, so pext_index inlines into it
+__attribute__((target("bmi2"))) uint64_t sliding_attacks_pext(int square, ChessBoard::Piece piece,
+                                                              uint64_t occupancy) {
+  uint64_t attacks = 0;
+  if (piece == ChessBoard::ROOK || piece == ChessBoard::QUEEN) {
+    attacks |= rook_magics[square].attacks[rook_magics[square].pext_index(occupancy)];
+  }
+  if (piece == ChessBoard::BISHOP || piece == ChessBoard::QUEEN) {
+    attacks |= bishop_magics[square].attacks[bishop_magics[square].pext_index(occupancy)];
+  }
+  return attacks;
+}
+#endif
+
+}  // namespace
+
+/**
+ * Build the process-wide slider lookup tables. Leaper tables are constexpr,
+ * so this is the only start-up work and it runs once no matter how many
+ * boards are created.
+ */
+void ChessBoard::initialize_attack_tables() {
+  std::call_once(magics_once, []() {
+#if defined(CHESS_USE_PEXT)
+    // Decided before the tables are filled, their layout follows the index
+    use_pext = __builtin_cpu_supports("bmi2");
+#endif
+    init_magics(ROOK_RAYS, ROOK_DIRECTIONS, ROOK_MAGICS, rook_magics, rook_table);
+    init_magics(BISHOP_RAYS, BISHOP_DIRECTIONS, BISHOP_MAGICS, bishop_magics, bishop_table);
+  });
 }
 
 void ChessBoard::set_initial_position() {
@@ -112,20 +363,29 @@ void ChessBoard::set_initial_position() {
   colors[ChessBoard::BLACK] = 0xFFFF000000000000ULL;  // ranks 7 and 8
 
   side_to_move = ChessBoard::WHITE;
+  en_passant = ChessBoard::NO_SQ;
 
   // Initialize castling rights
-  castling_rights[ChessBoard::WHITE][0] = castling_rights[ChessBoard::WHITE][1] = true;  // kingside, queenside
-  castling_rights[ChessBoard::BLACK][0] = castling_rights[ChessBoard::BLACK][1] = true;
+  castling_rights = ALL_CASTLING;
+  halfmove_clock = 0;
+  fullmove_number = 1;
+  undo_stack.ply = 0;
+  sync_mailbox();
+  hash_key = compute_hash();
 }
 
-ChessBoard::Piece ChessBoard::get_piece_at(ChessBoard::Square square) const {
-  ChessBoard::Bitboard mask = 1ULL << square;
-  for (int piece = ChessBoard::PAWN; piece <= ChessBoard::KING; ++piece) {
-    if (pieces[piece] & mask) {
-      return static_cast<ChessBoard::Piece>(piece);
-    }
+/**
+ * Rebuild the piece-on-square array from the bitboards
+ */
+void ChessBoard::sync_mailbox() {
+  mailbox.fill(NONE);
+  for (int piece = PAWN; piece <= KING; ++piece) {
+    for (Bitboard bb = pieces[piece]; bb; bb &= bb - 1) mailbox[__builtin_ctzll(bb)] = piece;
   }
-  return ChessBoard::NONE;
+}
+
+ChessBoard::Piece ChessBoard::get_piece_at(ChessBoard::Square square) const {
+  return static_cast<ChessBoard::Piece>(mailbox[square]);
 }
 
 ChessBoard::Color ChessBoard::get_color_at(ChessBoard::Square square) const {
@@ -136,38 +396,27 @@ ChessBoard::Color ChessBoard::get_color_at(ChessBoard::Square square) const {
 }
 
 ChessBoard::Bitboard ChessBoard::get_sliding_attacks(Square square, Piece piece) const {
-  Bitboard attacks = 0;
-  Bitboard occupancy = colors[WHITE] | colors[BLACK];
-
-  int x = square % 8;
-  int y = square / 8;
-
-  std::vector<std::pair<int, int>> directions;
+  return get_sliding_attacks(square, piece, colors[WHITE] | colors[BLACK]);
+}
 
+/**
+ * Sliding attacks for a given occupancy, resolved with one magic lookup per ray type
+ * @param square: square of the slider
+ * @param piece: BISHOP, ROOK or QUEEN
+ * @param occupancy: blockers to use instead of the current board occupancy
+ * @return attacked squares, including the first blocker on every ray
+ */
+ChessBoard::Bitboard ChessBoard::get_sliding_attacks(Square square, Piece piece, Bitboard occupancy) {
+#if defined(CHESS_USE_PEXT)
+  if (use_pext) return sliding_attacks_pext(square, piece, occupancy);
+#endif
+  Bitboard attacks = 0;
   if (piece == ROOK || piece == QUEEN) {
-    directions.insert(directions.end(), {{0, 1}, {1, 0}, {0, -1}, {-1, 0}});
+    attacks |= rook_magics[square].attacks[rook_magics[square].index(occupancy)];
   }
   if (piece == BISHOP || piece == QUEEN) {
-    directions.insert(directions.end(), {{1, 1}, {1, -1}, {-1, -1}, {-1, 1}});
-  }
-
-  for (const auto& [dx, dy] : directions) {
-    int new_x = x + dx;
-    int new_y = y + dy;
-
-    while (new_x >= 0 && new_x < 8 && new_y >= 0 && new_y < 8) {
-      int current_square = new_y * 8 + new_x;
-      attacks |= (1ULL << current_square);
-
-      if (occupancy & (1ULL << current_square)) {
-        break;
-      }
-
-      new_x += dx;
-      new_y += dy;
-    }
+    attacks |= bishop_magics[square].attacks[bishop_magics[square].index(occupancy)];
   }
-
   return attacks;
 }
 
@@ -179,7 +428,7 @@ ChessBoard::Bitboard ChessBoard::compute_attack_map(ChessBoard::Color attacking_
   ChessBoard::Bitboard pawns = pieces[ChessBoard::PAWN] & colors[attacking_color];
   while (pawns) {
     int square = __builtin_ctzll(pawns);
-    attack_map |= pawn_attacks[attacking_color][square];
+    attack_map |= PAWN_ATTACKS[attacking_color][square];
     pawns &= pawns - 1;  // Clear least significant bit
   }
 
@@ -187,7 +436,7 @@ ChessBoard::Bitboard ChessBoard::compute_attack_map(ChessBoard::Color attacking_
   ChessBoard::Bitboard knights = pieces[ChessBoard::KNIGHT] & colors[attacking_color];
   while (knights) {
     int square = __builtin_ctzll(knights);
-    attack_map |= knight_attacks[square];
+    attack_map |= KNIGHT_ATTACKS[square];
     knights &= knights - 1;
   }
 
@@ -195,7 +444,7 @@ ChessBoard::Bitboard ChessBoard::compute_attack_map(ChessBoard::Color attacking_
   ChessBoard::Bitboard kings = pieces[ChessBoard::KING] & colors[attacking_color];
   while (kings) {
     int square = __builtin_ctzll(kings);
-    attack_map |= king_attacks[square];
+    attack_map |= KING_ATTACKS[square];
     kings &= kings - 1;
   }
 
@@ -243,7 +492,7 @@ bool ChessBoard::is_castling_move_legal(ChessBoard::Square from, Square to) cons
 }
 
 bool ChessBoard::is_kingside_castling_legal(ChessBoard::Color color) const {
-  if (!castling_rights[color][0]) return false;  // No kingside castling right
+  if (!has_castling_right(color, 0)) return false;  // No kingside castling right
 
   int rank = (color == ChessBoard::WHITE) ? 0 : 7;
   Square king_square = static_cast<ChessBoard::Square>(ChessBoard::E1 + rank * 8);
@@ -258,14 +507,14 @@ bool ChessBoard::is_kingside_castling_legal(ChessBoard::Color color) const {
 
   // Check if king is not in check and doesn't move through check
   ChessBoard::Color opponent_color = (color == ChessBoard::WHITE) ? ChessBoard::BLACK : ChessBoard::WHITE;
-  ChessBoard::Bitboard opponent_attacks = compute_attack_map(opponent_color);
+  Bitboard enemy = colors[opponent_color];
 
-  return !(opponent_attacks & (1ULL << king_square)) && !(opponent_attacks & (1ULL << f_square)) &&
-         !(opponent_attacks & (1ULL << g_square));
+  return !(attackers_to(king_square, occupancy) & enemy) && !(attackers_to(f_square, occupancy) & enemy) &&
+         !(attackers_to(g_square, occupancy) & enemy);
 }
 
 bool ChessBoard::is_queenside_castling_legal(ChessBoard::Color color) const {
-  if (!castling_rights[color][1]) return false;  // No queenside castling right
+  if (!has_castling_right(color, 1)) return false;  // No queenside castling right
 
   int rank = (color == ChessBoard::WHITE) ? 0 : 7;
   Square king_square = static_cast<ChessBoard::Square>(ChessBoard::E1 + rank * 8);
@@ -281,10 +530,10 @@ bool ChessBoard::is_queenside_castling_legal(ChessBoard::Color color) const {
 
   // Check if king is not in check and doesn't move through check
   ChessBoard::Color opponent_color = (color == ChessBoard::WHITE) ? ChessBoard::BLACK : ChessBoard::WHITE;
-  ChessBoard::Bitboard opponent_attacks = compute_attack_map(opponent_color);
+  Bitboard enemy = colors[opponent_color];
 
-  return !(opponent_attacks & (1ULL << king_square)) && !(opponent_attacks & (1ULL << d_square)) &&
-         !(opponent_attacks & (1ULL << c_square));
+  return !(attackers_to(king_square, occupancy) & enemy) && !(attackers_to(d_square, occupancy) & enemy) &&
+         !(attackers_to(c_square, occupancy) & enemy);
 }
 
 /**
@@ -300,37 +549,6 @@ ChessBoard::Square ChessBoard::find_king_square(Color color) const {
   return static_cast<Square>(__builtin_ctzll(king_bitboard));
 }
 
-/**
- * Make a move on the board (for simulation purposes)
- * Note: This is a simplified version that doesn't handle special moves
- */
-void ChessBoard::make_move_on_board(Square from, Square to) {
-  Piece moving_piece = get_piece_at(from);
-  Color moving_color = get_color_at(from);
-
-  if (moving_piece == NONE) return;
-
-  // Clear the source square
-  pieces[moving_piece] &= ~(1ULL << from);
-  colors[moving_color] &= ~(1ULL << from);
-
-  // Clear the destination square (capture)
-  Piece captured_piece = get_piece_at(to);
-  if (captured_piece != NONE) {
-    Color captured_color = get_color_at(to);
-    pieces[captured_piece] &= ~(1ULL << to);
-    colors[captured_color] &= ~(1ULL << to);
-  }
-
-  // Set the destination square
-  pieces[moving_piece] |= (1ULL << to);
-  colors[moving_color] |= (1ULL << to);
-
-  // Switch side to move
-  // weird issue and I changed the code to this:
-  side_to_move = (side_to_move == WHITE) ? WHITE : BLACK;
-}
-
 bool ChessBoard::is_king_move_legal(ChessBoard::Square from, Square to) const {
   ChessBoard::Color moving_color = get_color_at(from);
   ChessBoard::Color opponent_color =
@@ -345,15 +563,15 @@ bool ChessBoard::is_king_move_legal(ChessBoard::Square from, Square to) const {
   if (dest_color == moving_color) return false;
 
   // Check if move is within king's movement pattern
-  ChessBoard::Bitboard king_moves = king_attacks[from];
+  ChessBoard::Bitboard king_moves = KING_ATTACKS[from];
   if (!(king_moves & (1ULL << to))) {
     // Not a normal king move, check for castling
     return is_castling_move_legal(from, to);
   }
 
-  // For normal moves: compute opponent's attack map and check if destination is safe
-  ChessBoard::Bitboard opponent_attacks = compute_attack_map(opponent_color);
-  return !(opponent_attacks & (1ULL << to));
+  // For normal moves: the destination must not be attacked once the king has left its square
+  Bitboard occupancy = (colors[WHITE] | colors[BLACK]) ^ (1ULL << from);
+  return !(attackers_to(to, occupancy) & colors[opponent_color]);
 }
 
 /**
@@ -382,9 +600,8 @@ bool ChessBoard::is_king_in_check(Color king_color) const {
     throw std::runtime_error("King not found on the board");
   }
 
-  // Compute opponent's attack map and check if king's square is attacked
-  Bitboard opponent_attacks = compute_attack_map(opponent_color);
-  return (opponent_attacks & (1ULL << king_square)) != 0;
+  // Look outward from the king instead of building the opponent's attack map
+  return (attackers_to(king_square, colors[WHITE] | colors[BLACK]) & colors[opponent_color]) != 0;
 }
 
 /**
@@ -404,82 +621,272 @@ bool ChessBoard::is_king_in_check_row_col(int king_row, int king_col) const {
 bool ChessBoard::is_current_player_in_check() const { return is_king_in_check(side_to_move); }
 
 /**
- * Check if the move would leave the king in check (simulates the move)
+ * Check if the move would leave the mover's king in check
+ * Resolved on bitboards without touching the board: the move is replayed on
+ * the occupancy and the captured piece is masked out of the attackers.
  * @param from: source square
  * @param to: destination square
  * @return true if the move would leave the king in check
  */
 bool ChessBoard::would_move_leave_king_in_check(Square from, Square to) const {
-  // Create a temporary copy of the board and make the move
-  ChessBoard temp_board = *this;
-  temp_board.make_move_on_board(from, to);
-  // Check if the king is in check after the move
-  return temp_board.is_current_player_in_check();
+  Color moving_color = get_color_at(from);
+  if (moving_color == BOTH) return is_current_player_in_check();
+  Color opponent_color = (moving_color == WHITE) ? BLACK : WHITE;
+
+  Square king_square = (get_piece_at(from) == KING) ? to : find_king_square(moving_color);
+  if (king_square == NO_SQ) {
+    throw std::runtime_error("King not found on the board");
+  }
+
+  Bitboard removed = 1ULL << to;
+  if (to == en_passant && get_piece_at(from) == PAWN) {
+    removed |= 1ULL << (to + ((moving_color == WHITE) ? -8 : 8));
+  }
+  Bitboard occupancy = (((colors[WHITE] | colors[BLACK]) ^ (1ULL << from)) & ~removed) | (1ULL << to);
+
+  return (attackers_to(king_square, occupancy) & colors[opponent_color] & ~removed) != 0;
 }
 
-// Set up a custom position for testing
+// Set up a custom position for testing (an empty string clears the board)
 ChessBoard::Square ChessBoard::set_custom_position(const std::string& fen) {
-  // Clear the board
-  for (int i = 0; i < 6; ++i) pieces[i] = 0;
-  for (int i = 0; i < 2; ++i) colors[i] = 0;
+  if (fen.empty() || !set_fen(fen)) {
+    for (int i = 0; i < 6; ++i) pieces[i] = 0;
+    for (int i = 0; i < 2; ++i) colors[i] = 0;
+    side_to_move = WHITE;
+    en_passant = NO_SQ;
+    castling_rights = 0;
+    halfmove_clock = 0;
+    fullmove_number = 1;
+    undo_stack.ply = 0;
+    sync_mailbox();
+    hash_key = compute_hash();
+  }
+  return find_king_square(WHITE);
+}
 
-  // Simple FEN parser for basic test positions
-  // This is a simplified parser - only handles piece placement
-  int rank = 7;
-  int file = 0;
+// =========================================================================
+// FEN - Parsing and serialization without heap allocation
+// =========================================================================
+
+namespace {
+
+// Split off the next space separated FEN field
+std::string_view next_fen_field(std::string_view& fen) {
+  size_t start = fen.find_first_not_of(' ');
+  if (start == std::string_view::npos) {
+    fen = {};
+    return {};
+  }
+  fen.remove_prefix(start);
+  size_t end = fen.find(' ');
+  std::string_view field = fen.substr(0, end);
+  fen.remove_prefix(end == std::string_view::npos ? fen.size() : end);
+  return field;
+}
 
-  Square king;
+bool parse_fen_number(std::string_view field, int max, int& value) {
+  if (field.empty() || field.size() > 5) return false;
+  value = 0;
+  for (char c : field) {
+    if (c < '0' || c > '9') return false;
+    value = value * 10 + (c - '0');
+  }
+  return value <= max;
+}
+
+char* write_fen_number(char* out, unsigned value) {
+  char digits[5];
+  int count = 0;
+  do {
+    digits[count++] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value && count < 5);
+  while (count) *out++ = digits[--count];
+  return out;
+}
 
-  std::string sfen = fen.substr(0, fen.find(' '));  // Get only piece placement part
+}  // namespace
 
-  for (char c : sfen) {
+/**
+ * Load a position from FEN
+ * Missing trailing fields default to "w - - 0 1". Castling rights are kept
+ * only when the king and rook are on their home squares, and the en passant
+ * square only when a double pushed pawn is actually behind it.
+ * @param fen: FEN string, placement field required
+ * @return false if the FEN is malformed, a side has no king or several, or
+ *         the side not to move is in check (the board is left untouched)
+ */
+bool ChessBoard::set_fen(std::string_view fen) {
+  std::array<uint8_t, 64> placement;  // piece | color << 3, NONE when empty
+  placement.fill(NONE);
+
+  std::string_view field = next_fen_field(fen);
+  int rank = 7;
+  int file = 0;
+  for (char c : field) {
     if (c == '/') {
+      if (file != 8 || rank == 0) return false;
       rank--;
       file = 0;
-    } else if (isdigit(c)) {
+    } else if (c >= '1' && c <= '8') {
       file += c - '0';
+      if (file > 8) return false;
     } else {
-      Piece piece;
-      Color color = isupper(c) ? WHITE : BLACK;
-
-      switch (tolower(c)) {
-        case 'p':
-          piece = PAWN;
-          break;
-        case 'n':
-          piece = KNIGHT;
-          break;
-        case 'b':
-          piece = BISHOP;
-          break;
-        case 'r':
-          piece = ROOK;
-          break;
-        case 'q':
-          piece = QUEEN;
-          break;
-        case 'k':
-          piece = KING;
-          break;
-        default:
-          continue;
+      const char* symbols = "pnbrqk";
+      const char* found = nullptr;
+      for (const char* symbol = symbols; *symbol; ++symbol) {
+        if (*symbol == (c | 0x20)) found = symbol;
       }
+      if (!found || file > 7) return false;
+      Color color = (c >= 'A' && c <= 'Z') ? WHITE : BLACK;
+      placement[rank * 8 + file] = static_cast<uint8_t>((found - symbols) | (color << 3));
+      file++;
+    }
+  }
+  if (rank != 0 || file != 8) return false;
+
+  Color side = WHITE;
+  field = next_fen_field(fen);
+  if (!field.empty()) {
+    if (field != "w" && field != "b") return false;
+    side = (field == "b") ? BLACK : WHITE;
+  }
+
+  uint8_t rights = 0;
+  field = next_fen_field(fen);
+  if (!field.empty() && field != "-") {
+    for (char c : field) {
+      if (c == 'K') rights |= 0x01;
+      else if (c == 'Q') rights |= 0x02;
+      else if (c == 'k') rights |= 0x04;
+      else if (c == 'q') rights |= 0x08;
+      else return false;
+    }
+  }
+
+  Square ep_square = NO_SQ;
+  field = next_fen_field(fen);
+  if (!field.empty() && field != "-") {
+    if (field.size() != 2 || field[0] < 'a' || field[0] > 'h' || field[1] < '1' || field[1] > '8') return false;
+    ep_square = static_cast<Square>((field[1] - '1') * 8 + (field[0] - 'a'));
+  }
+
+  int halfmove = 0;
+  int fullmove = 1;
+  field = next_fen_field(fen);
+  if (!field.empty() && !parse_fen_number(field, 0xFFFF, halfmove)) return false;
+  field = next_fen_field(fen);
+  if (!field.empty() && !parse_fen_number(field, 0xFFFF, fullmove)) return false;
+
+  std::array<Bitboard, 6> new_pieces{};
+  std::array<Bitboard, 2> new_colors{};
+  for (int square = 0; square < 64; ++square) {
+    if (placement[square] == NONE) continue;
+    new_pieces[placement[square] & 7] |= 1ULL << square;
+    new_colors[placement[square] >> 3] |= 1ULL << square;
+  }
+
+  // Exactly one king per side, and the side that just moved can not be in check
+  Color them = (side == WHITE) ? BLACK : WHITE;
+  if (__builtin_popcountll(new_pieces[KING] & new_colors[WHITE]) != 1 ||
+      __builtin_popcountll(new_pieces[KING] & new_colors[BLACK]) != 1) {
+    return false;
+  }
+  Square their_king = static_cast<Square>(__builtin_ctzll(new_pieces[KING] & new_colors[them]));
+  Bitboard occupancy = new_colors[WHITE] | new_colors[BLACK];
+  Bitboard checkers = (PAWN_ATTACKS[them][their_king] & new_pieces[PAWN]) |
+                      (KNIGHT_ATTACKS[their_king] & new_pieces[KNIGHT]) | (KING_ATTACKS[their_king] & new_pieces[KING]) |
+                      (get_sliding_attacks(their_king, ROOK, occupancy) & (new_pieces[ROOK] | new_pieces[QUEEN])) |
+                      (get_sliding_attacks(their_king, BISHOP, occupancy) & (new_pieces[BISHOP] | new_pieces[QUEEN]));
+  if (checkers & new_colors[side]) return false;
+
+  // Everything parsed and legal, commit to the board
+  pieces = new_pieces;
+  colors = new_colors;
+  sync_mailbox();
+
+  auto has = [this](int square, Piece piece, Color color) {
+    return mailbox[square] == piece && (colors[color] & (1ULL << square));
+  };
+  if (!has(E1, KING, WHITE)) rights &= ~0x03;
+  if (!has(H1, ROOK, WHITE)) rights &= ~0x01;
+  if (!has(A1, ROOK, WHITE)) rights &= ~0x02;
+  if (!has(E8, KING, BLACK)) rights &= ~0x0C;
+  if (!has(H8, ROOK, BLACK)) rights &= ~0x04;
+  if (!has(A8, ROOK, BLACK)) rights &= ~0x08;
+
+  if (ep_square != NO_SQ) {
+    // The pawn that just double pushed sits in front of the en passant square
+    int pawn_square = ep_square + ((side == WHITE) ? -8 : 8);
+    bool valid = (ep_square / 8 == ((side == WHITE) ? 5 : 2)) && mailbox[ep_square] == NONE &&
+                 has(pawn_square, PAWN, them);
+    if (!valid) ep_square = NO_SQ;
+  }
+
+  side_to_move = side;
+  castling_rights = rights;
+  en_passant = ep_square;
+  halfmove_clock = static_cast<uint16_t>(halfmove);
+  fullmove_number = static_cast<uint16_t>(fullmove > 0 ? fullmove : 1);
+  undo_stack.ply = 0;
+  hash_key = compute_hash();
+  return true;
+}
+
+/**
+ * Write the position as FEN (all six fields)
+ * @param out: destination buffer, FEN_BUFFER_SIZE bytes always suffice
+ * @param size: size of the buffer
+ * @return length written (excluding the NUL), 0 if the buffer is too small
+ */
+size_t ChessBoard::get_fen(char* out, size_t size) const {
+  char buffer[FEN_BUFFER_SIZE];
+  char* p = buffer;
 
+  for (int rank = 7; rank >= 0; --rank) {
+    int empty = 0;
+    for (int file = 0; file < 8; ++file) {
       int square = rank * 8 + file;
-      if (piece == KING && color == WHITE) {
-        king = static_cast<Square>(square);
+      if (mailbox[square] == NONE) {
+        empty++;
+        continue;
       }
-      set_piece(static_cast<Square>(square), piece, color);
-      file++;
+      if (empty) *p++ = static_cast<char>('0' + empty);
+      empty = 0;
+      char symbol = "pnbrqk"[mailbox[square]];
+      *p++ = (colors[WHITE] & (1ULL << square)) ? static_cast<char>(symbol - 32) : symbol;
     }
-    side_to_move = WHITE;
+    if (empty) *p++ = static_cast<char>('0' + empty);
+    if (rank) *p++ = '/';
+  }
+
+  *p++ = ' ';
+  *p++ = (side_to_move == WHITE) ? 'w' : 'b';
+
+  *p++ = ' ';
+  if (!castling_rights) *p++ = '-';
+  for (int bit = 0; bit < 4; ++bit) {
+    if (castling_rights & (1 << bit)) *p++ = "KQkq"[bit];
+  }
+
+  *p++ = ' ';
+  if (en_passant == NO_SQ) {
+    *p++ = '-';
+  } else {
+    *p++ = static_cast<char>('a' + en_passant % 8);
+    *p++ = static_cast<char>('1' + en_passant / 8);
   }
 
-  // Reset castling rights for custom positions
-  castling_rights[WHITE][0] = castling_rights[WHITE][1] = false;
-  castling_rights[BLACK][0] = castling_rights[BLACK][1] = false;
-  
-  return king;
+  *p++ = ' ';
+  p = write_fen_number(p, halfmove_clock);
+  *p++ = ' ';
+  p = write_fen_number(p, fullmove_number);
+
+  size_t length = static_cast<size_t>(p - buffer);
+  if (length + 1 > size) return 0;
+  std::memcpy(out, buffer, length);
+  out[length] = '\0';
+  return length;
 }
 
 // Helper function to set a piece on the board
@@ -487,15 +894,575 @@ void ChessBoard::set_piece(Square square, Piece piece, Color color) {
   Bitboard mask = 1ULL << square;
 
   // Clear any existing piece on this square
-  for (int i = 0; i < 6; ++i) {
-    pieces[i] &= ~mask;
-  }
+  if (mailbox[square] != NONE) pieces[mailbox[square]] &= ~mask;
   colors[WHITE] &= ~mask;
   colors[BLACK] &= ~mask;
 
   // Set the new piece
   pieces[piece] |= mask;
   colors[color] |= mask;
+  mailbox[square] = piece;
+  hash_key = compute_hash();
+}
+
+// =========================================================================
+// MOVE GENERATION
+// =========================================================================
+
+/**
+ * All pieces of both colors attacking a square
+ * @param square: target square
+ * @param occupancy: blockers to use for slider rays
+ * @return bitboard of attackers (mask with colors[] to pick a side)
+ */
+ChessBoard::Bitboard ChessBoard::attackers_to(Square square, Bitboard occupancy) const {
+  Bitboard rooks_queens = pieces[ROOK] | pieces[QUEEN];
+  Bitboard bishops_queens = pieces[BISHOP] | pieces[QUEEN];
+  return (PAWN_ATTACKS[BLACK][square] & pieces[PAWN] & colors[WHITE]) |
+         (PAWN_ATTACKS[WHITE][square] & pieces[PAWN] & colors[BLACK]) |
+         (KNIGHT_ATTACKS[square] & pieces[KNIGHT]) | (KING_ATTACKS[square] & pieces[KING]) |
+         (get_sliding_attacks(square, ROOK, occupancy) & rooks_queens) |
+         (get_sliding_attacks(square, BISHOP, occupancy) & bishops_queens);
+}
+
+/**
+ * Pieces of the given color that are pinned against their own king
+ * @param color: side whose pinned pieces are wanted
+ * @return bitboard of pinned pieces
+ */
+ChessBoard::Bitboard ChessBoard::pinned(Color color) const {
+  Square king = find_king_square(color);
+  if (king == NO_SQ) return 0;
+
+  Color opponent = (color == WHITE) ? BLACK : WHITE;
+  Bitboard occupancy = colors[WHITE] | colors[BLACK];
+  Bitboard snipers = ((ROOK_RAYS[king] & (pieces[ROOK] | pieces[QUEEN])) |
+                      (BISHOP_RAYS[king] & (pieces[BISHOP] | pieces[QUEEN]))) &
+                     colors[opponent];
+
+  Bitboard pinned_mask = 0;
+  while (snipers) {
+    int sniper = __builtin_ctzll(snipers);
+    Bitboard blockers = BETWEEN[king][sniper] & occupancy;
+    // Exactly one blocker, and it is ours
+    if (blockers && !(blockers & (blockers - 1)) && (blockers & colors[color])) {
+      pinned_mask |= blockers;
+    }
+    snipers &= snipers - 1;
+  }
+  return pinned_mask;
+}
+
+/**
+ * Enemy pieces giving check to the king of the side to move
+ * @return bitboard of checking pieces (0 when not in check)
+ */
+ChessBoard::Bitboard ChessBoard::checkers() const {
+  Square king = find_king_square(side_to_move);
+  if (king == NO_SQ) return 0;
+  Color opponent = (side_to_move == WHITE) ? BLACK : WHITE;
+  return attackers_to(king, colors[WHITE] | colors[BLACK]) & colors[opponent];
+}
+
+/**
+ * Static exchange evaluation of a move: the material balance once every
+ * piece attacking the destination has recaptured, least valuable first,
+ * with either side free to stop when recapturing would lose.
+ * Attackers revealed behind sliders (x-rays) join as pieces are lifted off
+ * the occupancy. Pins are not considered.
+ * @param move: move of the piece on move.from(), either color
+ * @return gain for the moving side in SEE_VALUES units, negative when it loses material
+ */
+int ChessBoard::see(Move move) const {
+  if (move.is_castling()) return 0;
+
+  const Square from = static_cast<Square>(move.from());
+  const Square to = static_cast<Square>(move.to());
+  const Bitboard diagonal = pieces[BISHOP] | pieces[QUEEN];
+  const Bitboard orthogonal = pieces[ROOK] | pieces[QUEEN];
+
+  Bitboard occupancy = (colors[WHITE] | colors[BLACK]) ^ (1ULL << from);
+  Color side = (colors[WHITE] & (1ULL << from)) ? BLACK : WHITE;  // side to recapture
+  int attacker = mailbox[from];
+
+  int gain[32];
+  int depth = 0;
+  if (move.is_en_passant()) {
+    occupancy ^= 1ULL << (to + (side == BLACK ? -8 : 8));
+    gain[0] = SEE_VALUES[PAWN];
+  } else {
+    gain[0] = SEE_VALUES[mailbox[to]];
+  }
+  if (move.is_promotion()) {
+    attacker = move.promotion_piece();
+    gain[0] += SEE_VALUES[attacker] - SEE_VALUES[PAWN];
+  }
+
+  Bitboard attackers = attackers_to(to, occupancy) & occupancy;
+  while (depth < 31) {
+    Bitboard ours = attackers & colors[side];
+    if (!ours) break;
+
+    // Least valuable attacker
+    int piece = PAWN;
+    while (!(ours & pieces[piece])) piece++;
+    // The king can only take last
+    if (piece == KING && (attackers & colors[side ^ 1])) break;
+
+    depth++;
+    gain[depth] = SEE_VALUES[attacker] - gain[depth - 1];
+
+    Bitboard candidates = ours & pieces[piece];
+    occupancy ^= candidates & (~candidates + 1);
+    if (piece == PAWN || piece == BISHOP || piece == QUEEN) {
+      attackers |= get_sliding_attacks(to, BISHOP, occupancy) & diagonal;
+    }
+    if (piece == ROOK || piece == QUEEN) {
+      attackers |= get_sliding_attacks(to, ROOK, occupancy) & orthogonal;
+    }
+    attackers &= occupancy;
+    attacker = piece;
+    side = static_cast<Color>(side ^ 1);
+  }
+
+  while (depth > 0) {
+    gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+    depth--;
+  }
+  return gain[0];
+}
+
+/**
+ * Pieces the opponent wins material by capturing (best SEE above zero)
+ * @param color: side whose pieces are checked, the king is never included
+ * @return bitboard of hanging pieces
+ */
+ChessBoard::Bitboard ChessBoard::hanging_pieces(Color color) const {
+  const Color opponent = (color == WHITE) ? BLACK : WHITE;
+  const Bitboard occupancy = colors[WHITE] | colors[BLACK];
+  const Bitboard last_rank = (opponent == WHITE) ? 0xFF00000000000000ULL : 0xFFULL;
+
+  Bitboard hanging = 0;
+  Bitboard targets = colors[color] & ~pieces[KING];
+  while (targets) {
+    Square target = static_cast<Square>(__builtin_ctzll(targets));
+    targets &= targets - 1;
+
+    Bitboard attackers = attackers_to(target, occupancy) & colors[opponent];
+    while (attackers) {
+      int from = __builtin_ctzll(attackers);
+      attackers &= attackers - 1;
+      bool promotes = mailbox[from] == PAWN && (last_rank & (1ULL << target));
+      if (see(Move(from, target, promotes ? Move::PROMOTION_CAPTURE + 3 : Move::CAPTURE)) > 0) {
+        hanging |= 1ULL << target;
+        break;
+      }
+    }
+  }
+  return hanging;
+}
+
+/**
+ * Shared pseudo-legal / legal generator.
+ * In LEGAL mode king moves are tested against attackers with the king lifted
+ * off the board, other moves are restricted to the check-evasion mask and to
+ * the pin line of pinned pieces, so no move is ever made to test legality.
+ */
+template <bool LEGAL>
+void ChessBoard::generate_moves(MoveList& moves) const {
+  const Color us = side_to_move;
+  const Color them = (us == WHITE) ? BLACK : WHITE;
+  const Bitboard own = colors[us];
+  const Bitboard enemy = colors[them];
+  const Bitboard occupancy = own | enemy;
+  const Square king = find_king_square(us);
+
+  Bitboard target = ~own;
+  Bitboard checking = 0;
+  Bitboard pinned_mask = 0;
+
+  // King steps
+  if (king != NO_SQ) {
+    Bitboard steps = KING_ATTACKS[king] & ~own;
+    while (steps) {
+      Square to = static_cast<Square>(__builtin_ctzll(steps));
+      steps &= steps - 1;
+      if (LEGAL && (attackers_to(to, occupancy ^ (1ULL << king)) & enemy)) continue;
+      moves.add(Move(king, to, (enemy & (1ULL << to)) ? Move::CAPTURE : Move::QUIET));
+    }
+
+    checking = attackers_to(king, occupancy) & enemy;
+    if (LEGAL) {
+      // Double check: only the king can move
+      if (checking & (checking - 1)) return;
+      if (checking) target &= BETWEEN[king][__builtin_ctzll(checking)] | checking;
+      pinned_mask = pinned(us);
+    }
+  }
+
+  // Restricts a destination set to the pin line when the piece is pinned
+  auto pin_filter = [&](Square from, Bitboard destinations) {
+    if (LEGAL && (pinned_mask & (1ULL << from))) destinations &= LINE[king][from];
+    return destinations;
+  };
+
+  auto add_targets = [&](Square from, Bitboard destinations) {
+    while (destinations) {
+      int to = __builtin_ctzll(destinations);
+      moves.add(Move(from, to, (enemy & (1ULL << to)) ? Move::CAPTURE : Move::QUIET));
+      destinations &= destinations - 1;
+    }
+  };
+
+  // Knights, bishops, rooks and queens
+  for (int piece = KNIGHT; piece <= QUEEN; ++piece) {
+    Bitboard movers = pieces[piece] & own;
+    while (movers) {
+      Square from = static_cast<Square>(__builtin_ctzll(movers));
+      movers &= movers - 1;
+      Bitboard attacks = (piece == KNIGHT) ? KNIGHT_ATTACKS[from]
+                                           : get_sliding_attacks(from, static_cast<Piece>(piece), occupancy);
+      add_targets(from, pin_filter(from, attacks & target));
+    }
+  }
+
+  // Pawns
+  const int push = (us == WHITE) ? 8 : -8;
+  const Bitboard start_rank = (us == WHITE) ? 0xFF00ULL : 0x00FF000000000000ULL;
+  const Bitboard last_rank = (us == WHITE) ? RANK_8 : RANK_1;
+
+  Bitboard pawns = pieces[PAWN] & own;
+  while (pawns) {
+    Square from = static_cast<Square>(__builtin_ctzll(pawns));
+    pawns &= pawns - 1;
+
+    Bitboard destinations = PAWN_ATTACKS[us][from] & enemy;
+    int single = from + push;
+    if (!(occupancy & (1ULL << single))) {
+      destinations |= 1ULL << single;
+      int twice = single + push;
+      if ((start_rank & (1ULL << from)) && !(occupancy & (1ULL << twice))) {
+        destinations |= 1ULL << twice;
+      }
+    }
+    destinations = pin_filter(from, destinations & target);
+
+    while (destinations) {
+      int to = __builtin_ctzll(destinations);
+      destinations &= destinations - 1;
+      bool capture = (enemy & (1ULL << to)) != 0;
+      if ((1ULL << to) & last_rank) {
+        int base = capture ? Move::PROMOTION_CAPTURE : Move::PROMOTION;
+        for (int promo = 3; promo >= 0; --promo) moves.add(Move(from, to, base + promo));
+      } else if (capture) {
+        moves.add(Move(from, to, Move::CAPTURE));
+      } else {
+        moves.add(Move(from, to, (to - from == 2 * push) ? Move::DOUBLE_PAWN_PUSH : Move::QUIET));
+      }
+    }
+
+    // En passant: rare enough to verify by replaying the capture on the
+    // occupancy, which also covers the captured pawn being a checker and
+    // the rank-pin where both pawns leave the king's rank at once
+    if (en_passant != NO_SQ && (PAWN_ATTACKS[us][from] & (1ULL << en_passant))) {
+      Square captured = static_cast<Square>(en_passant - push);
+      if (LEGAL && king != NO_SQ) {
+        Bitboard after = (occupancy ^ (1ULL << from) ^ (1ULL << captured)) | (1ULL << en_passant);
+        if (attackers_to(king, after) & enemy & ~(1ULL << captured)) continue;
+      }
+      moves.add(Move(from, en_passant, Move::EN_PASSANT));
+    }
+  }
+
+  // Castling: rights, rook in place, empty path, king not in or passing through check
+  if (king != NO_SQ && !checking) {
+    int rank = (us == WHITE) ? 0 : 56;
+    Bitboard own_rooks = pieces[ROOK] & own;
+    if (king == E1 + rank) {
+      if (has_castling_right(us, 0) && (own_rooks & (1ULL << (H1 + rank))) &&
+          !(occupancy & ((1ULL << (F1 + rank)) | (1ULL << (G1 + rank)))) &&
+          !(attackers_to(static_cast<Square>(F1 + rank), occupancy) & enemy) &&
+          !(attackers_to(static_cast<Square>(G1 + rank), occupancy) & enemy)) {
+        moves.add(Move(king, G1 + rank, Move::KING_CASTLE));
+      }
+      if (has_castling_right(us, 1) && (own_rooks & (1ULL << (A1 + rank))) &&
+          !(occupancy & ((1ULL << (B1 + rank)) | (1ULL << (C1 + rank)) | (1ULL << (D1 + rank)))) &&
+          !(attackers_to(static_cast<Square>(D1 + rank), occupancy) & enemy) &&
+          !(attackers_to(static_cast<Square>(C1 + rank), occupancy) & enemy)) {
+        moves.add(Move(king, C1 + rank, Move::QUEEN_CASTLE));
+      }
+    }
+  }
+}
+
+/**
+ * Generate pseudo-legal moves (may leave the own king in check)
+ * @param moves: list to append to
+ */
+void ChessBoard::generate_pseudo_legal_moves(MoveList& moves) const { generate_moves<false>(moves); }
+
+/**
+ * Generate strictly legal moves for the side to move
+ * @param moves: list to append to
+ */
+void ChessBoard::generate_legal_moves(MoveList& moves) const { generate_moves<true>(moves); }
+
+/**
+ * Play a move on the board, with full rules: captures, en passant,
+ * castling rook hop, promotion, castling rights and side to move.
+ * The state needed to take it back is pushed on the undo stack.
+ * @param move: a legal move for the side to move
+ */
+void ChessBoard::make_move(Move move) {
+  const Color us = side_to_move;
+  const Color them = (us == WHITE) ? BLACK : WHITE;
+  const Square from = static_cast<Square>(move.from());
+  const Square to = static_cast<Square>(move.to());
+  const Piece moving_piece = get_piece_at(from);
+  const Bitboard from_to = (1ULL << from) | (1ULL << to);
+
+  UndoInfo& undo = undo_stack.push();
+  undo.hash = hash_key;
+  undo.captured = NONE;
+  undo.castling_rights = castling_rights;
+  undo.en_passant = en_passant;
+  undo.halfmove_clock = halfmove_clock;
+
+  // Drop the old en passant and castling terms, they are re-added below
+  uint64_t key = hash_key ^ en_passant_key() ^ ZOBRIST.castling[castling_rights] ^ ZOBRIST.side;
+
+  if (move.is_en_passant()) {
+    int captured_square = to + ((us == WHITE) ? -8 : 8);
+    pieces[PAWN] &= ~(1ULL << captured_square);
+    colors[them] &= ~(1ULL << captured_square);
+    mailbox[captured_square] = NONE;
+    key ^= ZOBRIST.pieces[them][PAWN][captured_square];
+    undo.captured = PAWN;
+  } else if (move.is_capture()) {
+    undo.captured = mailbox[to];
+    pieces[undo.captured] &= ~(1ULL << to);
+    colors[them] &= ~(1ULL << to);
+    key ^= ZOBRIST.pieces[them][undo.captured][to];
+  }
+
+  pieces[moving_piece] ^= from_to;
+  colors[us] ^= from_to;
+  mailbox[from] = NONE;
+  mailbox[to] = moving_piece;
+  key ^= ZOBRIST.pieces[us][moving_piece][from] ^ ZOBRIST.pieces[us][moving_piece][to];
+
+  if (move.is_promotion()) {
+    pieces[PAWN] &= ~(1ULL << to);
+    pieces[move.promotion_piece()] |= 1ULL << to;
+    mailbox[to] = move.promotion_piece();
+    key ^= ZOBRIST.pieces[us][PAWN][to] ^ ZOBRIST.pieces[us][move.promotion_piece()][to];
+  } else if (move.is_castling()) {
+    bool kingside = move.flags() == Move::KING_CASTLE;
+    int rank = (us == WHITE) ? 0 : 56;
+    int rook_from = (kingside ? H1 : A1) + rank;
+    int rook_to = (kingside ? F1 : D1) + rank;
+    Bitboard rook_hop = castling_rook_hop(us, kingside);
+    pieces[ROOK] ^= rook_hop;
+    colors[us] ^= rook_hop;
+    mailbox[rook_from] = NONE;
+    mailbox[rook_to] = ROOK;
+    key ^= ZOBRIST.pieces[us][ROOK][rook_from] ^ ZOBRIST.pieces[us][ROOK][rook_to];
+  }
+
+  castling_rights &= CASTLING_MASK[from] & CASTLING_MASK[to];
+  en_passant = (move.flags() == Move::DOUBLE_PAWN_PUSH) ? static_cast<Square>((from + to) / 2) : NO_SQ;
+  halfmove_clock = (moving_piece == PAWN || undo.captured != NONE) ? 0 : halfmove_clock + 1;
+  if (us == BLACK) fullmove_number++;
+  side_to_move = them;
+
+  hash_key = key ^ ZOBRIST.castling[castling_rights] ^ en_passant_key();
+}
+
+/**
+ * Match a move in UCI coordinate notation against the legal moves
+ * A missing promotion letter promotes to a queen.
+ * @param uci: "e2e4", "e7e8q", ...
+ * @return the legal move, a null move if the text matches none
+ */
+Move ChessBoard::find_uci_move(std::string_view uci) const {
+  if (uci.size() < 4) return Move();
+  if (uci[0] < 'a' || uci[0] > 'h' || uci[1] < '1' || uci[1] > '8') return Move();
+  if (uci[2] < 'a' || uci[2] > 'h' || uci[3] < '1' || uci[3] > '8') return Move();
+  int from = (uci[1] - '1') * 8 + (uci[0] - 'a');
+  int to = (uci[3] - '1') * 8 + (uci[2] - 'a');
+  char promotion = uci.size() > 4 ? uci[4] : 'q';
+
+  MoveList moves;
+  generate_legal_moves(moves);
+  for (const Move& move : moves) {
+    if (move.from() != from || move.to() != to) continue;
+    if (move.is_promotion() && "nbrq"[move.flags() & 3] != promotion) continue;
+    return move;
+  }
+  return Move();
+}
+
+/**
+ * Match a move in standard algebraic notation (as found in PGN) against
+ * the legal moves. Check marks and annotations are ignored, castling may be
+ * written with letter O or digit 0.
+ * @param san: "e4", "Nbd7", "exd6", "R1e2", "e8=Q+", "O-O-O", ...
+ * @return the legal move, a null move if the text matches none or is ambiguous
+ */
+Move ChessBoard::find_san_move(std::string_view san) const {
+  while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' || san.back() == '?')) {
+    san.remove_suffix(1);
+  }
+  if (san.size() < 2) return Move();
+
+  MoveList moves;
+  generate_legal_moves(moves);
+
+  if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+    int flag = san.size() == 3 ? Move::KING_CASTLE : Move::QUEEN_CASTLE;
+    for (const Move& move : moves) {
+      if (move.flags() == flag) return move;
+    }
+    return Move();
+  }
+
+  Piece piece = PAWN;
+  switch (san.front()) {
+    case 'N': piece = KNIGHT; break;
+    case 'B': piece = BISHOP; break;
+    case 'R': piece = ROOK; break;
+    case 'Q': piece = QUEEN; break;
+    case 'K': piece = KING; break;
+    default: break;
+  }
+  if (piece != PAWN) san.remove_prefix(1);
+
+  // Promotion suffix, "=Q" or a bare "Q"
+  int promotion = NONE;
+  if (piece == PAWN && san.size() >= 3) {
+    size_t letter = std::string_view("NBRQ").find(san.back());
+    if (letter != std::string_view::npos) {
+      promotion = KNIGHT + static_cast<int>(letter);
+      san.remove_suffix(1);
+      if (san.back() == '=') san.remove_suffix(1);
+    }
+  }
+
+  if (san.size() < 2) return Move();
+  char to_file = san[san.size() - 2];
+  char to_rank = san[san.size() - 1];
+  if (to_file < 'a' || to_file > 'h' || to_rank < '1' || to_rank > '8') return Move();
+  int to = (to_rank - '1') * 8 + (to_file - 'a');
+  san.remove_suffix(2);
+
+  // What is left is the disambiguation, possibly followed by 'x'
+  int from_file = -1;
+  int from_rank = -1;
+  for (char c : san) {
+    if (c >= 'a' && c <= 'h') from_file = c - 'a';
+    else if (c >= '1' && c <= '8') from_rank = c - '1';
+    else if (c != 'x' && c != ':') return Move();
+  }
+
+  Move match;
+  int matches = 0;
+  for (const Move& move : moves) {
+    if (move.to() != to || mailbox[move.from()] != piece) continue;
+    if (from_file >= 0 && move.from() % 8 != from_file) continue;
+    if (from_rank >= 0 && move.from() / 8 != from_rank) continue;
+    if (move.is_promotion() && move.promotion_piece() != (promotion == NONE ? QUEEN : promotion)) continue;
+    if (!move.is_promotion() && promotion != NONE) continue;
+    match = move;
+    matches++;
+  }
+  return matches == 1 ? match : Move();
+}
+
+/**
+ * Take back the last move played with make_move
+ * @param move: the same move that was passed to make_move
+ */
+void ChessBoard::unmake_move(Move move) {
+  const UndoInfo& undo = undo_stack.pop();
+  const Color them = side_to_move;
+  const Color us = (them == WHITE) ? BLACK : WHITE;
+  const Square from = static_cast<Square>(move.from());
+  const Square to = static_cast<Square>(move.to());
+  const Bitboard from_to = (1ULL << from) | (1ULL << to);
+
+  if (move.is_promotion()) {
+    pieces[move.promotion_piece()] &= ~(1ULL << to);
+    pieces[PAWN] |= 1ULL << to;
+    mailbox[to] = PAWN;
+  } else if (move.is_castling()) {
+    bool kingside = move.flags() == Move::KING_CASTLE;
+    int rank = (us == WHITE) ? 0 : 56;
+    Bitboard rook_hop = castling_rook_hop(us, kingside);
+    pieces[ROOK] ^= rook_hop;
+    colors[us] ^= rook_hop;
+    mailbox[(kingside ? F1 : D1) + rank] = NONE;
+    mailbox[(kingside ? H1 : A1) + rank] = ROOK;
+  }
+
+  pieces[mailbox[to]] ^= from_to;
+  colors[us] ^= from_to;
+  mailbox[from] = mailbox[to];
+  mailbox[to] = NONE;
+
+  if (move.is_en_passant()) {
+    int captured_square = to + ((us == WHITE) ? -8 : 8);
+    pieces[PAWN] |= 1ULL << captured_square;
+    colors[them] |= 1ULL << captured_square;
+    mailbox[captured_square] = PAWN;
+  } else if (undo.captured != NONE) {
+    pieces[undo.captured] |= 1ULL << to;
+    colors[them] |= 1ULL << to;
+    mailbox[to] = undo.captured;
+  }
+
+  castling_rights = undo.castling_rights;
+  en_passant = static_cast<Square>(undo.en_passant);
+  halfmove_clock = undo.halfmove_clock;
+  if (us == BLACK) fullmove_number--;
+  hash_key = undo.hash;
+  side_to_move = us;
+}
+
+/**
+ * Zobrist key of the position, computed from scratch
+ * Covers pieces, side to move, castling rights and the en passant file
+ * (only when a pawn can actually capture there).
+ * @return 64-bit position key
+ */
+uint64_t ChessBoard::compute_hash() const {
+  uint64_t key = 0;
+  for (int color = WHITE; color <= BLACK; ++color) {
+    for (int piece = PAWN; piece <= KING; ++piece) {
+      Bitboard bb = pieces[piece] & colors[color];
+      while (bb) {
+        key ^= ZOBRIST.pieces[color][piece][__builtin_ctzll(bb)];
+        bb &= bb - 1;
+      }
+    }
+  }
+  key ^= ZOBRIST.castling[castling_rights];
+  key ^= en_passant_key();
+  if (side_to_move == BLACK) key ^= ZOBRIST.side;
+  return key;
+}
+
+/**
+ * Hash term for the en passant square, non-zero only when a pawn of the
+ * side to move can actually capture there (so unreachable en passant
+ * squares don't split otherwise identical positions)
+ */
+uint64_t ChessBoard::en_passant_key() const {
+  if (en_passant == NO_SQ) return 0;
+  Color them = (side_to_move == WHITE) ? BLACK : WHITE;
+  if (PAWN_ATTACKS[them][en_passant] & pieces[PAWN] & colors[side_to_move]) {
+    return ZOBRIST.en_passant_file[en_passant % 8];
+  }
+  return 0;
 }
 
 // =========================================================================
@@ -5,11 +5,14 @@
 #include <array>
 #include <bitset>
 #include <iostream>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#include "move.h"
 
 class ChessBoard {
-private:
+public:
     // Bitboard definitions (Little-endian rank-file mapping)
  using Bitboard = uint64_t;
 
@@ -31,22 +34,58 @@ private:
   A8, B8, C8, D8, E8, F8, G8, H8, NO_SQ
  };
 
- // Precomputed attack tables
- std::array<Bitboard, 64> knight_attacks;
- std::array<Bitboard, 64> king_attacks;
- std::array<std::array<Bitboard, 64>, 2> pawn_attacks;  // [color][square]
-
- // Magic bitboard tables for sliding pieces (simplified version)
- std::array<Bitboard, 64> rook_attacks_base;
- std::array<Bitboard, 64> bishop_attacks_base;
-
- // Board state
+private:
+ // Board state (attack tables are process-wide, see bitboard.cpp)
  std::array<Bitboard, 6> pieces;  // [PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING]
  std::array<Bitboard, 2> colors;  // [WHITE, BLACK]
  Color side_to_move;
+ Square en_passant;  // square behind a pawn that just moved two ranks, or NO_SQ
+
+ // Castling rights: bit 0/1 white kingside/queenside, bit 2/3 black
+ static constexpr uint8_t ALL_CASTLING = 0x0F;
+ uint8_t castling_rights;
+ uint16_t halfmove_clock;
+ uint16_t fullmove_number;
+
+ // Piece on each square (NONE when empty), kept in sync with the bitboards
+ // so get_piece_at is a single load
+ std::array<uint8_t, 64> mailbox;
+ void sync_mailbox();
+
+ // Zobrist key, updated incrementally by make_move/unmake_move
+ uint64_t hash_key;
+ uint64_t en_passant_key() const;
+
+ // Undo stack for make_move/unmake_move. A ring: only the last MAX_PLY
+ // moves can be taken back, which covers any search or game replay.
+ struct UndoInfo {
+   uint64_t hash;            // Zobrist key before the move
+   uint8_t captured;         // Piece taken by the move, NONE if quiet
+   uint8_t castling_rights;  // Rights before the move
+   uint8_t en_passant;       // En passant square before the move
+   uint16_t halfmove_clock;  // Halfmove clock before the move
+ };
+ static constexpr int MAX_PLY = 256;
+
+ // The 4KB ring is not part of the position value: a copied board starts
+ // with an empty stack, so copies cost about 150 bytes, not the whole ring.
+ // Moves made before the copy can only be taken back on the original.
+ struct UndoStack {
+   std::array<UndoInfo, MAX_PLY> entries;
+   int ply = 0;
+
+   UndoStack() = default;
+   UndoStack(const UndoStack&) {}
+   UndoStack& operator=(const UndoStack&) {
+     ply = 0;
+     return *this;
+   }
+   UndoInfo& push() { return entries[ply++ & (MAX_PLY - 1)]; }
+   const UndoInfo& pop() { return entries[--ply & (MAX_PLY - 1)]; }
+ };
+ UndoStack undo_stack;
 
- // Castling rights
- bool castling_rights[2][2];  // [color][kingside/queenside]
+ bool has_castling_right(Color color, int side) const { return castling_rights & (1 << (color * 2 + side)); }
 
 public:
  ChessBoard() {
@@ -55,24 +94,39 @@ public:
  }
 
 private:
- void initialize_attack_tables();
- void set_initial_position();
+ static void initialize_attack_tables();
 
- Piece get_piece_at(Square square) const;
- Color get_color_at(Square square) const;
  Bitboard get_sliding_attacks(Square square, Piece piece) const;
+ static Bitboard get_sliding_attacks(Square square, Piece piece, Bitboard occupancy);
  Bitboard compute_attack_map(Color attacking_color) const;
 
+ template <bool LEGAL>
+ void generate_moves(MoveList& moves) const;
+
  bool is_castling_move_legal(Square from, Square to) const;
  bool is_kingside_castling_legal(Color color) const;
  bool is_queenside_castling_legal(Color color) const;
- Square find_king_square(Color color) const;
- void make_move_on_board(Square from, Square to);
 
 public:
- typedef Square Square;
- typedef Piece Piece;
- typedef Color Color;
+ void set_initial_position();
+
+ // Square queries (get_color_at returns BOTH for an empty square)
+ Piece get_piece_at(Square square) const;
+ Color get_color_at(Square square) const;
+ Square find_king_square(Color color) const;
+ Bitboard get_pieces(Piece piece, Color color) const { return pieces[piece] & colors[color]; }
+ Bitboard get_occupancy(Color color) const { return color == BOTH ? colors[WHITE] | colors[BLACK] : colors[color]; }
+
+ // Attack queries, resolved outward from the target square with slider lookups
+ Bitboard attackers_to(Square square, Bitboard occupancy) const;
+ Bitboard checkers() const;
+ Bitboard pinned(Color color) const;
+
+ // Static exchange evaluation, bitboards only (no make/unmake)
+ static constexpr int SEE_VALUES[7] = {100, 320, 330, 500, 900, 20000, 0};  // [PAWN..KING, NONE]
+ int see(Move move) const;
+ Bitboard hanging_pieces(Color color) const;
+
  bool is_king_move_legal(Square from, Square to) const;
  bool is_king_move_legal(int from_row, int from_col, int to_row, int to_col) const;
  bool is_king_in_check(Color king_color) const;
@@ -82,8 +136,44 @@ public:
  Square from_row_col(int row, int col) const;
  std::pair<int, int> to_row_col(Square square) const;
 
+ // Move generation (legal moves use pin and checker masks, no make/unmake)
+ void generate_pseudo_legal_moves(MoveList& moves) const;
+ void generate_legal_moves(MoveList& moves) const;
+ Color get_side_to_move() const { return side_to_move; }
+ Move find_uci_move(std::string_view uci) const;
+ Move find_san_move(std::string_view san) const;
+
+ // Applying moves and position identity
+ void make_move(Move move);
+ void unmake_move(Move move);
+ int get_halfmove_clock() const { return halfmove_clock; }
+ uint64_t get_hash() const { return hash_key; }
+ uint64_t compute_hash() const;
+
+ // Position setup beyond piece placement (side, castling, en passant)
+ void set_side_to_move(Color color) {
+   side_to_move = color;
+   hash_key = compute_hash();
+ }
+ void set_castling_right(Color color, bool kingside, bool allowed) {
+   uint8_t bit = 1 << (color * 2 + (kingside ? 0 : 1));
+   castling_rights = allowed ? (castling_rights | bit) : (castling_rights & ~bit);
+   hash_key = compute_hash();
+ }
+ void set_en_passant(Square square) {
+   en_passant = square;
+   hash_key = compute_hash();
+ }
+ bool can_castle(Color color, bool kingside) const { return has_castling_right(color, kingside ? 0 : 1); }
+ Square get_en_passant() const { return en_passant; }
+
  void set_piece(Square square, Piece piece, Color color);
  Square set_custom_position(const std::string& fen = "");
+
+ // FEN round-trip (side, castling, en passant and both clocks included)
+ static constexpr size_t FEN_BUFFER_SIZE = 96;
+ bool set_fen(std::string_view fen);
+ size_t get_fen(char* out, size_t size) const;
  
  void print_board() const;
  void print_attack_map(Color color) const;
@@ -0,0 +1,146 @@
+#include "engine_cache.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+EngineCache::EngineCache(size_t capacity) : capacity(capacity > 0 ? capacity : 1) {
+  const char* homeDir = std::getenv("HOME");
+  if (!homeDir) {
+    std::cerr << "[CACH] HOME not set, engine cache kept in memory only" << std::endl;
+    return;
+  }
+  cachePath = std::string(homeDir) + "/.chessboard/engine_cache.bin";
+  load();
+}
+
+EngineCache::~EngineCache() {
+  save();
+}
+
+uint32_t EngineCache::packLimits(int depth, uint32_t move_time) {
+  return (static_cast<uint32_t>(depth) & 0xFFFF) << 16 | (move_time & 0xFFFF);
+}
+
+uint64_t EngineCache::indexKey(uint64_t position, uint32_t limits) {
+  return position ^ (limits * 0x9E3779B97F4A7C15ULL);
+}
+
+bool EngineCache::lookup(uint64_t position, int depth, uint32_t move_time, std::string& move) {
+  uint32_t limits = packLimits(depth, move_time);
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto it = index.find(indexKey(position, limits));
+  if (it == index.end() || it->second->position != position || it->second->limits != limits) {
+    misses++;
+    return false;
+  }
+
+  entries.splice(entries.begin(), entries, it->second);
+  move = it->second->move;
+  hits++;
+  return true;
+}
+
+void EngineCache::store(uint64_t position, int depth, uint32_t move_time, const std::string& move) {
+  if (move.empty() || move.size() >= sizeof(Entry::move)) return;
+
+  Entry entry = {};
+  entry.position = position;
+  entry.limits = packLimits(depth, move_time);
+  std::memcpy(entry.move, move.c_str(), move.size() + 1);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  insert(entry);
+  dirty = true;
+}
+
+// Caller holds the mutex
+void EngineCache::insert(const Entry& entry) {
+  uint64_t key = indexKey(entry.position, entry.limits);
+  auto it = index.find(key);
+  if (it != index.end()) {
+    entries.erase(it->second);
+    index.erase(it);
+  } else if (entries.size() >= capacity) {
+    index.erase(indexKey(entries.back().position, entries.back().limits));
+    entries.pop_back();
+  }
+  entries.push_front(entry);
+  index[key] = entries.begin();
+}
+
+bool EngineCache::load() {
+  if (cachePath.empty() || !std::filesystem::exists(cachePath)) return false;
+
+  std::ifstream file(cachePath, std::ios::binary);
+  uint32_t magic = 0;
+  uint32_t count = 0;
+  file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+  file.read(reinterpret_cast<char*>(&count), sizeof(count));
+  if (!file || magic != FILE_MAGIC) {
+    std::cerr << "[CACH] Ignoring invalid cache file: " << cachePath << std::endl;
+    return false;
+  }
+
+  // Never trust the header count beyond what the file can hold
+  size_t available = (std::filesystem::file_size(cachePath) - 2 * sizeof(uint32_t)) / sizeof(Entry);
+  std::vector<Entry> records(std::min<size_t>(count, available));
+  file.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(Entry));
+  records.resize(file.gcount() / sizeof(Entry));
+
+  std::lock_guard<std::mutex> lock(mutex);
+  entries.clear();
+  index.clear();
+  // Oldest first, so the most recent record ends up at the front
+  for (Entry& record : records) {
+    record.move[sizeof(record.move) - 1] = '\0';
+    if (record.move[0] != '\0') insert(record);
+  }
+  dirty = false;
+
+  std::cout << "[CACH] Loaded " << entries.size() << " engine answers from: " << cachePath << std::endl;
+  return true;
+}
+
+bool EngineCache::save() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (cachePath.empty() || !dirty) return false;
+
+  std::error_code error;
+  std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path(), error);
+  std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    std::cerr << "[CACH] Could not open cache file for writing: " << cachePath << std::endl;
+    return false;
+  }
+
+  uint32_t magic = FILE_MAGIC;
+  uint32_t count = static_cast<uint32_t>(entries.size());
+  file.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+  file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+  for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+    file.write(reinterpret_cast<const char*>(&*it), sizeof(Entry));
+  }
+  dirty = false;
+
+  std::cout << "[CACH] Saved " << count << " engine answers (" << hits << " hits, " << misses
+            << " misses this session)" << std::endl;
+  return static_cast<bool>(file);
+}
+
+void EngineCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  entries.clear();
+  index.clear();
+  dirty = true;
+}
+
+size_t EngineCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries.size();
+}
@@ -0,0 +1,76 @@
+#ifndef ENGINE_CACHE_H
+#define ENGINE_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Bounded LRU cache of engine answers, kept in memory and persisted to
+ * ~/.chessboard/engine_cache.bin between runs.
+ *
+ * Entries are keyed by the Zobrist hash of the position (pieces, side to
+ * move, castling rights and a capturable en passant square, so move clocks
+ * and move order do not matter) plus the depth and move time limits the
+ * answer was searched with.
+ */
+class EngineCache {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+    EngineCache(size_t capacity = DEFAULT_CAPACITY);
+    ~EngineCache();
+
+    EngineCache(const EngineCache&) = delete;
+    EngineCache& operator=(const EngineCache&) = delete;
+
+    /**
+     * Look up a stored best move, refreshing its LRU position on a hit
+     * @param move: receives the best move in UCI notation
+     * @return true on a hit
+     */
+    bool lookup(uint64_t position, int depth, uint32_t move_time, std::string& move);
+
+    // Store or refresh an answer, evicting the least recently used entry when full
+    void store(uint64_t position, int depth, uint32_t move_time, const std::string& move);
+
+    bool load();
+    bool save();
+    void clear();
+
+    uint64_t getHits() const { return hits; }
+    uint64_t getMisses() const { return misses; }
+    size_t size() const;
+
+private:
+    // On-disk record, written oldest first so a reload keeps the LRU order
+    struct Entry {
+        uint64_t position;
+        uint32_t limits;   // depth << 16 | move time in seconds
+        char move[6];      // UCI move, NUL terminated
+        uint16_t reserved;
+    };
+    static_assert(sizeof(Entry) == 24, "cache record layout");
+    static constexpr uint32_t FILE_MAGIC = 0x31434345;  // "ECC1"
+
+    size_t capacity;
+    std::string cachePath;
+    bool dirty = false;
+
+    // Most recently used at the front
+    std::list<Entry> entries;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+    mutable std::mutex mutex;
+
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+
+    static uint32_t packLimits(int depth, uint32_t move_time);
+    static uint64_t indexKey(uint64_t position, uint32_t limits);
+    void insert(const Entry& entry);
+};
+
+#endif // ENGINE_CACHE_H
@@ -0,0 +1,274 @@
+#include "engine_supervisor.h"
+
+#include <csignal>
+#include <iostream>
+
+EngineSupervisor::~EngineSupervisor() {
+  shutdown();
+}
+
+bool EngineSupervisor::start(const std::string& enginePath) {
+  if (running) return true;
+
+  // A crashed engine must not take the GUI down on the next write
+  std::signal(SIGPIPE, SIG_IGN);
+
+  engine_path = enginePath;
+  if (!cache) cache = std::make_shared<EngineCache>();
+
+  std::unique_ptr<UCIEngine> first = launch();
+  if (!first) return false;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  active = std::move(first);
+  running = true;
+  supervisor_thread = std::make_unique<std::thread>(&EngineSupervisor::superviseLoop, this);
+  std::cout << "[SUPV] Engine ready, starting a standby" << std::endl;
+  return true;
+}
+
+void EngineSupervisor::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+  supervisor_cv.notify_all();
+  if (supervisor_thread && supervisor_thread->joinable()) {
+    supervisor_thread->join();
+  }
+
+  // The supervisor thread is gone, every engine can be stopped from here
+  retired.clear();
+  standby.reset();
+  active.reset();
+}
+
+// A new engine past uciok/readyok with the current settings, nullptr when it fails
+std::unique_ptr<UCIEngine> EngineSupervisor::launch() {
+  auto engine = std::make_unique<UCIEngine>();
+  engine->setCache(cache);
+  // Wake the supervisor right away instead of at the next heartbeat
+  engine->setErrorCallback([this](const std::string&) {
+    engine_trouble = true;
+    supervisor_cv.notify_all();
+  });
+  if (!engine->startEngine(false, engine_path)) return nullptr;
+
+  engine->sendCommand("uci");
+  bool ready = engine->waitForResponse("uciok");
+  if (ready) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      engine->setPonder(ponder);
+      engine->setDifficult(difficult);
+      engine->setMoveTime(move_time);
+    }
+    engine->sendCommand("isready");
+    ready = engine->waitForResponse("readyok");
+  }
+  if (!ready) {
+    std::cerr << "[SUPV] " << engine_path << " did not complete the UCI handshake" << std::endl;
+    return nullptr;
+  }
+  return engine;
+}
+
+void EngineSupervisor::superviseLoop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (running) {
+    supervisor_cv.wait_for(lock, std::chrono::milliseconds(HEARTBEAT_MS),
+                           [this] { return !running || !retired.empty() || engine_trouble; });
+    if (!running) break;
+    bool trouble = engine_trouble.exchange(false);
+
+    // Replaced engines are shut down here, never on the game thread
+    if (!retired.empty()) {
+      std::vector<std::unique_ptr<UCIEngine>> done;
+      done.swap(retired);
+      lock.unlock();
+      done.clear();
+      lock.lock();
+      if (!running) break;
+    }
+
+    // Heartbeat
+    UCIEngine* engine = active.get();
+    if (!engine->isRunning()) {
+      failover(lock, "Engine process exited");
+    } else if (engine->hasTimedOut()) {
+      failover(lock, "Engine search never answered");
+    } else if (!trouble && !engine->isBusy()) {
+      // Searches are covered by their own deadline, only idle engines get pinged
+      lock.unlock();
+      bool alive = engine->isResponsive(HEARTBEAT_TIMEOUT_MS);
+      lock.lock();
+      if (!running) break;
+      if (!alive && active.get() == engine) failover(lock, "Engine missed the heartbeat");
+    }
+
+    // Keep a warm standby
+    if ((!standby || !standby->isRunning()) && std::chrono::steady_clock::now() >= next_launch) {
+      std::unique_ptr<UCIEngine> dead = std::move(standby);
+      lock.unlock();
+      dead.reset();
+      std::unique_ptr<UCIEngine> fresh = launch();
+      lock.lock();
+      standby = std::move(fresh);
+      if (standby) std::cout << "[SUPV] Standby engine ready" << std::endl;
+      else next_launch = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    }
+  }
+}
+
+// Caller holds lock. The standby (or a new engine when there is none) takes
+// over and the game is replayed on it, the old engine is shut down later
+bool EngineSupervisor::failover(std::unique_lock<std::mutex>& lock, const char* reason) {
+  std::cerr << "[SUPV] " << reason << ", switching to the standby" << std::endl;
+
+  std::unique_ptr<UCIEngine> next = std::move(standby);
+  if (!next || !next->isRunning()) {
+    if (next) retired.push_back(std::move(next));
+    lock.unlock();
+    next = launch();
+    lock.lock();
+  }
+  if (!next) {
+    std::cerr << "[SUPV] No engine could be started" << std::endl;
+    return false;
+  }
+
+  retired.push_back(std::move(active));
+  active = std::move(next);
+  replay(*active);
+  return true;
+}
+
+// Caller holds mutex. Bring a fresh engine to the current game and hand it
+// the search that is still waiting for a move, if any
+void EngineSupervisor::replay(UCIEngine& engine) {
+  Request waiting;
+  {
+    std::lock_guard<std::mutex> lock(request_mutex);
+    if (request.waiting) {
+      request.id++;  // the old engine may still answer, ignore it
+      waiting.id = request.id;
+      waiting.waiting = true;
+      waiting.from_fen = request.from_fen;
+      waiting.fen = request.fen;
+    }
+  }
+
+  engine.newGame();
+  bool resend_move = waiting.waiting && !waiting.from_fen && !history.empty();
+  size_t known = history.size() - (resend_move ? 1 : 0);
+  for (size_t i = 0; i < known; i++) {
+    engine.addMoveToHistory(history[i]);
+  }
+
+  if (!waiting.waiting) return;
+  std::cout << "[SUPV] Replaying the pending search" << std::endl;
+  if (waiting.from_fen) engine.sendPositionAsync(waiting.fen, answer(waiting.id));
+  else if (resend_move) engine.sendMoveAsync(history.back(), answer(waiting.id));
+}
+
+// Remember the request so a failover can replay it
+EngineSupervisor::MoveCallback EngineSupervisor::beginRequest(bool from_fen, const std::string& fen,
+                                                              MoveCallback callback) {
+  std::lock_guard<std::mutex> lock(request_mutex);
+  request.id++;
+  request.waiting = true;
+  request.from_fen = from_fen;
+  request.fen = fen;
+  request.callback = std::move(callback);
+  return answer(request.id);
+}
+
+// Engine callback for one request, later answers to it are dropped
+EngineSupervisor::MoveCallback EngineSupervisor::answer(uint64_t id) {
+  return [this, id](Move move) {
+    MoveCallback callback;
+    {
+      std::lock_guard<std::mutex> lock(request_mutex);
+      if (!request.waiting || request.id != id) return;
+      request.waiting = false;
+      callback = std::move(request.callback);
+    }
+    if (callback) callback(move);
+  };
+}
+
+void EngineSupervisor::sendMoveAsync(Move move, MoveCallback callback) {
+  std::lock_guard<std::mutex> lock(mutex);
+  history.push_back(move);
+  MoveCallback deliver = beginRequest(false, std::string(), std::move(callback));
+  if (active) active->sendMoveAsync(move, deliver);
+}
+
+void EngineSupervisor::sendPositionAsync(const std::string& fen, MoveCallback callback) {
+  std::lock_guard<std::mutex> lock(mutex);
+  MoveCallback deliver = beginRequest(true, fen, std::move(callback));
+  if (active) active->sendPositionAsync(fen, deliver);
+}
+
+void EngineSupervisor::addMoveToHistory(Move move) {
+  std::lock_guard<std::mutex> lock(mutex);
+  history.push_back(move);
+  if (active) active->addMoveToHistory(move);
+}
+
+void EngineSupervisor::newGame() {
+  MoveCallback dropped;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    history.clear();
+    {
+      std::lock_guard<std::mutex> request_lock(request_mutex);
+      if (request.waiting) dropped = std::move(request.callback);
+      request.waiting = false;
+      request.callback = nullptr;
+    }
+
+    // An engine still searching or pondering the old game is swapped for the
+    // idle standby instead of being stopped, and retired in the background
+    if (active && active->isBusy() && standby && standby->isRunning()) {
+      retired.push_back(std::move(active));
+      active = std::move(standby);
+      supervisor_cv.notify_one();
+    }
+    if (active) active->newGame();
+  }
+
+  // The search of the old game is answered with no move, the caller stops waiting
+  if (dropped) dropped(Move());
+}
+
+void EngineSupervisor::sendCommand(const std::string& command) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (active) active->sendCommand(command);
+}
+
+void EngineSupervisor::setDifficult(int difficult) {
+  std::lock_guard<std::mutex> lock(mutex);
+  this->difficult = difficult;
+  if (active) active->setDifficult(difficult);
+  if (standby) standby->setDifficult(difficult);
+}
+
+void EngineSupervisor::setMoveTime(uint32_t move_time) {
+  std::lock_guard<std::mutex> lock(mutex);
+  this->move_time = move_time;
+  if (active) active->setMoveTime(move_time);
+  if (standby) standby->setMoveTime(move_time);
+}
+
+void EngineSupervisor::setPonder(bool enabled) {
+  std::lock_guard<std::mutex> lock(mutex);
+  ponder = enabled;
+  if (active) active->setPonder(enabled);
+  if (standby) standby->setPonder(enabled);
+}
+
+bool EngineSupervisor::getSearchInfo(SearchInfo& info) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return active && active->getSearchInfo(info);
+}
@@ -0,0 +1,104 @@
+#ifndef ENGINE_SUPERVISOR_H
+#define ENGINE_SUPERVISOR_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bitboard.h"
+#include "engine_cache.h"
+#include "uci_engine.h"
+
+/**
+ * Keeps gnuchess answering: an active UCIEngine plays, a standby process is
+ * started in the background and kept past uciok/readyok.
+ *
+ * A supervisor thread checks the active engine every HEARTBEAT_MS: a dead
+ * process, a search without bestmove or an idle engine not answering
+ * "isready" makes the standby take over. The game so far and any search
+ * still waiting for its move are replayed on it, and a new standby is
+ * started. A new game also swaps in the standby, so an engine busy with the
+ * previous game never delays it.
+ *
+ * Only the answer to the latest request reaches the callback, answers from
+ * a replaced engine or from before a new game are dropped. A request still
+ * waiting when a new game starts gets a null move instead.
+ */
+class EngineSupervisor {
+public:
+    using MoveCallback = UCIEngine::MoveCallback;
+
+    static constexpr int HEARTBEAT_MS = 1000;
+    static constexpr int HEARTBEAT_TIMEOUT_MS = 2000;
+
+    EngineSupervisor() = default;
+    ~EngineSupervisor();
+
+    EngineSupervisor(const EngineSupervisor&) = delete;
+    EngineSupervisor& operator=(const EngineSupervisor&) = delete;
+
+    /**
+     * Start the active engine, its handshake is the only blocking part
+     * @return false when the engine can not be started
+     */
+    bool start(const std::string& enginePath = "/usr/games/gnuchess");
+    void shutdown();
+
+    // Same call pattern as UCIEngine
+    void sendMoveAsync(Move move, MoveCallback callback = nullptr);
+    void sendPositionAsync(const std::string& fen, MoveCallback callback = nullptr);
+    void addMoveToHistory(Move move);
+    void newGame();
+    void sendCommand(const std::string& command);
+    void setDifficult(int difficult);
+    void setMoveTime(uint32_t move_time);
+    void setPonder(bool enabled);
+    bool getSearchInfo(SearchInfo& info);
+
+private:
+    std::string engine_path;
+    std::shared_ptr<EngineCache> cache;  // one answer cache for every process
+
+    // Engines and game mirror, guarded by mutex
+    std::unique_ptr<UCIEngine> active;
+    std::unique_ptr<UCIEngine> standby;
+    std::vector<std::unique_ptr<UCIEngine>> retired;  // shut down by the supervisor thread
+    std::vector<Move> history;
+    int difficult = 1;
+    uint32_t move_time = 2;
+    bool ponder = false;
+    std::mutex mutex;
+
+    // Search waiting for its move, guarded by request_mutex so engine
+    // callbacks never wait on the engine calls made under mutex
+    struct Request {
+        uint64_t id = 0;
+        bool waiting = false;
+        bool from_fen = false;
+        std::string fen;
+        MoveCallback callback;
+    };
+    Request request;
+    std::mutex request_mutex;
+
+    std::unique_ptr<std::thread> supervisor_thread;
+    std::condition_variable supervisor_cv;
+    bool running = false;
+    std::atomic<bool> engine_trouble{false};  // set from engine threads, they never take mutex
+    std::chrono::steady_clock::time_point next_launch;  // backoff after a failed standby start
+
+    std::unique_ptr<UCIEngine> launch();
+    void superviseLoop();
+    bool failover(std::unique_lock<std::mutex>& lock, const char* reason);
+    void replay(UCIEngine& engine);
+    MoveCallback beginRequest(bool from_fen, const std::string& fen, MoveCallback callback);
+    MoveCallback answer(uint64_t id);
+};
+
+#endif // ENGINE_SUPERVISOR_H
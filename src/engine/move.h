@@ -0,0 +1,92 @@
+#ifndef MOVE_H
+#define MOVE_H
+
+#include <array>
+#include <cstdint>
+
+/**
+ * Packed 16-bit move
+ * bits 0-5: source square, bits 6-11: destination square, bits 12-15: flags
+ * Squares use the bitboard numbering (A1 = 0, H8 = 63).
+ */
+class Move {
+public:
+ enum Flag : uint16_t {
+   QUIET = 0,
+   DOUBLE_PAWN_PUSH = 1,
+   KING_CASTLE = 2,
+   QUEEN_CASTLE = 3,
+   CAPTURE = 4,
+   EN_PASSANT = 5,
+   PROMOTION = 8,          // + 0..3 for knight, bishop, rook, queen
+   PROMOTION_CAPTURE = 12  // + 0..3 for knight, bishop, rook, queen
+ };
+
+ constexpr Move() : data(0) {}
+ constexpr Move(int from, int to, int flags = QUIET)
+     : data(static_cast<uint16_t>(from | (to << 6) | (flags << 12))) {}
+
+ constexpr int from() const { return data & 0x3F; }
+ constexpr int to() const { return (data >> 6) & 0x3F; }
+ constexpr int flags() const { return data >> 12; }
+ constexpr uint16_t raw() const { return data; }
+
+ constexpr bool is_null() const { return data == 0; }
+ constexpr bool is_capture() const { return (flags() & CAPTURE) != 0; }
+ constexpr bool is_promotion() const { return (flags() & PROMOTION) != 0; }
+ constexpr bool is_castling() const { return flags() == KING_CASTLE || flags() == QUEEN_CASTLE; }
+ constexpr bool is_en_passant() const { return flags() == EN_PASSANT; }
+
+ // Promotion piece as a ChessBoard::Piece value (KNIGHT = 1 .. QUEEN = 4)
+ constexpr int promotion_piece() const { return (flags() & 3) + 1; }
+
+ constexpr bool operator==(const Move& other) const { return data == other.data; }
+ constexpr bool operator!=(const Move& other) const { return data != other.data; }
+
+ /**
+  * Write the move in UCI coordinate notation ("e2e4", "e7e8q")
+  * @param out: buffer of at least 6 chars, always NUL terminated
+  * @return number of characters written (4 or 5)
+  */
+ int to_uci(char* out) const {
+   out[0] = static_cast<char>('a' + from() % 8);
+   out[1] = static_cast<char>('1' + from() / 8);
+   out[2] = static_cast<char>('a' + to() % 8);
+   out[3] = static_cast<char>('1' + to() / 8);
+   if (is_promotion()) {
+     out[4] = "nbrq"[flags() & 3];
+     out[5] = '\0';
+     return 5;
+   }
+   out[4] = '\0';
+   return 4;
+ }
+
+private:
+ uint16_t data;
+};
+
+/**
+ * Fixed-capacity move list, meant to live on the stack.
+ * 256 slots covers the known maximum of 218 legal moves in any position.
+ */
+struct MoveList {
+ static constexpr int CAPACITY = 256;
+
+ std::array<Move, CAPACITY> moves;
+ int count = 0;
+
+ void add(Move move) { moves[count++] = move; }
+ void clear() { count = 0; }
+ int size() const { return count; }
+ bool empty() const { return count == 0; }
+
+ Move& operator[](int index) { return moves[index]; }
+ const Move& operator[](int index) const { return moves[index]; }
+ Move* begin() { return moves.data(); }
+ Move* end() { return moves.data() + count; }
+ const Move* begin() const { return moves.data(); }
+ const Move* end() const { return moves.data() + count; }
+};
+
+#endif // MOVE_H
@@ -0,0 +1,52 @@
+#ifndef POLYGLOT_BOOK_H
+#define POLYGLOT_BOOK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+
+#include "bitboard.h"
+
+/**
+ * Read-only Polyglot opening book (.bin).
+ * The file is memory-mapped and binary-searched by the Polyglot key of the
+ * position, entries are 16 bytes big-endian sorted by key:
+ * key (64), move (16), weight (16), learn (32).
+ */
+class PolyglotBook {
+public:
+    PolyglotBook() = default;
+    ~PolyglotBook();
+
+    PolyglotBook(const PolyglotBook&) = delete;
+    PolyglotBook& operator=(const PolyglotBook&) = delete;
+
+    // Map a book file, a leading "~/" is expanded to $HOME
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return entries != nullptr; }
+
+    /**
+     * Pick a book move for the position, weighted by the entry weights
+     * @param move: receives a legal move of the position
+     * @return false when the position is not in the book
+     */
+    bool probe(const ChessBoard& board, Move& move);
+
+    // Polyglot hash of a position (differs from ChessBoard::get_hash)
+    static uint64_t key(const ChessBoard& board);
+
+private:
+    static constexpr size_t ENTRY_SIZE = 16;
+
+    const unsigned char* entries = nullptr;
+    size_t entry_count = 0;
+    size_t mapped_size = 0;
+    std::mt19937 rng{std::random_device{}()};
+
+    uint64_t entryKey(size_t index) const;
+    Move decodeMove(const ChessBoard& board, uint16_t move) const;
+};
+
+#endif // POLYGLOT_BOOK_H
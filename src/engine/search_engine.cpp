@@ -0,0 +1,489 @@
+#include "search_engine.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// Material in centipawns, indexed by ChessBoard::Piece
+constexpr int PIECE_VALUES[6] = {100, 320, 330, 500, 900, 0};
+
+// Piece-square tables from white's point of view, rank 8 first
+// (Simplified Evaluation Function). White pieces index with square ^ 56.
+constexpr int PAWN_TABLE[64] = {
+     0,  0,  0,  0,  0,  0,  0,  0,
+    50, 50, 50, 50, 50, 50, 50, 50,
+    10, 10, 20, 30, 30, 20, 10, 10,
+     5,  5, 10, 25, 25, 10,  5,  5,
+     0,  0,  0, 20, 20,  0,  0,  0,
+     5, -5,-10,  0,  0,-10, -5,  5,
+     5, 10, 10,-20,-20, 10, 10,  5,
+     0,  0,  0,  0,  0,  0,  0,  0};
+constexpr int KNIGHT_TABLE[64] = {
+   -50,-40,-30,-30,-30,-30,-40,-50,
+   -40,-20,  0,  0,  0,  0,-20,-40,
+   -30,  0, 10, 15, 15, 10,  0,-30,
+   -30,  5, 15, 20, 20, 15,  5,-30,
+   -30,  0, 15, 20, 20, 15,  0,-30,
+   -30,  5, 10, 15, 15, 10,  5,-30,
+   -40,-20,  0,  5,  5,  0,-20,-40,
+   -50,-40,-30,-30,-30,-30,-40,-50};
+constexpr int BISHOP_TABLE[64] = {
+   -20,-10,-10,-10,-10,-10,-10,-20,
+   -10,  0,  0,  0,  0,  0,  0,-10,
+   -10,  0,  5, 10, 10,  5,  0,-10,
+   -10,  5,  5, 10, 10,  5,  5,-10,
+   -10,  0, 10, 10, 10, 10,  0,-10,
+   -10, 10, 10, 10, 10, 10, 10,-10,
+   -10,  5,  0,  0,  0,  0,  5,-10,
+   -20,-10,-10,-10,-10,-10,-10,-20};
+constexpr int ROOK_TABLE[64] = {
+     0,  0,  0,  0,  0,  0,  0,  0,
+     5, 10, 10, 10, 10, 10, 10,  5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+     0,  0,  0,  5,  5,  0,  0,  0};
+constexpr int QUEEN_TABLE[64] = {
+   -20,-10,-10, -5, -5,-10,-10,-20,
+   -10,  0,  0,  0,  0,  0,  0,-10,
+   -10,  0,  5,  5,  5,  5,  0,-10,
+    -5,  0,  5,  5,  5,  5,  0, -5,
+     0,  0,  5,  5,  5,  5,  0, -5,
+   -10,  5,  5,  5,  5,  5,  0,-10,
+   -10,  0,  5,  0,  0,  0,  0,-10,
+   -20,-10,-10, -5, -5,-10,-10,-20};
+constexpr int KING_MIDDLE_TABLE[64] = {
+   -30,-40,-40,-50,-50,-40,-40,-30,
+   -30,-40,-40,-50,-50,-40,-40,-30,
+   -30,-40,-40,-50,-50,-40,-40,-30,
+   -30,-40,-40,-50,-50,-40,-40,-30,
+   -20,-30,-30,-40,-40,-30,-30,-20,
+   -10,-20,-20,-20,-20,-20,-20,-10,
+    20, 20,  0,  0,  0,  0, 20, 20,
+    20, 30, 10,  0,  0, 10, 30, 20};
+constexpr int KING_END_TABLE[64] = {
+   -50,-40,-30,-20,-20,-30,-40,-50,
+   -30,-20,-10,  0,  0,-10,-20,-30,
+   -30,-10, 20, 30, 30, 20,-10,-30,
+   -30,-10, 30, 40, 40, 30,-10,-30,
+   -30,-10, 30, 40, 40, 30,-10,-30,
+   -30,-10, 20, 30, 30, 20,-10,-30,
+   -30,-30,  0,  0,  0,  0,-30,-30,
+   -50,-30,-30,-30,-30,-30,-30,-50};
+
+constexpr const int* PIECE_TABLES[5] = {PAWN_TABLE, KNIGHT_TABLE, BISHOP_TABLE, ROOK_TABLE, QUEEN_TABLE};
+
+// Game phase weight of each piece, 24 with all minor and major pieces on board
+constexpr int PHASE_WEIGHTS[6] = {0, 1, 1, 2, 4, 0};
+constexpr int MAX_PHASE = 24;
+
+}  // namespace
+
+SearchEngine::SearchEngine(size_t hash_mb) {
+  // Round down to a power of two entry count for mask indexing
+  size_t entries = 1;
+  while (entries * 2 * sizeof(TTEntry) <= hash_mb * 1024 * 1024) entries *= 2;
+  tt.assign(entries, TTEntry{0, 0, 0, 0, BOUND_NONE});
+  tt_mask = entries - 1;
+
+  game_hashes.push_back(board.get_hash());
+  search_thread = std::make_unique<std::thread>(&SearchEngine::searchLoop, this);
+}
+
+SearchEngine::~SearchEngine() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop_flag = true;
+    thread_running = false;
+  }
+  search_cv.notify_one();
+  if (search_thread && search_thread->joinable()) search_thread->join();
+}
+
+void SearchEngine::sendMoveAsync(Move move, MoveCallback callback) {
+  MoveCallback dropped;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    playMove(move);
+    dropped = requestSearch(callback);
+  }
+  search_cv.notify_one();
+  if (dropped) dropped(Move());
+}
+
+void SearchEngine::sendPositionAsync(const ChessBoard& position, MoveCallback callback) {
+  MoveCallback dropped;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    board = position;
+    game_hashes.assign(1, board.get_hash());
+    dropped = requestSearch(callback);
+  }
+  search_cv.notify_one();
+  if (dropped) dropped(Move());
+}
+
+void SearchEngine::addMoveToHistory(Move move) {
+  std::lock_guard<std::mutex> lock(mutex);
+  playMove(move);
+}
+
+// Caller holds the mutex
+void SearchEngine::playMove(Move move) {
+  MoveList moves;
+  board.generate_legal_moves(moves);
+  if (std::find(moves.begin(), moves.end(), move) == moves.end()) {
+    char uci[6];
+    move.to_uci(uci);
+    std::cerr << "[SRCH] Ignoring illegal move: " << uci << std::endl;
+    return;
+  }
+  board.make_move(move);
+  game_hashes.push_back(board.get_hash());
+}
+
+/**
+ * Queue a search of the current board. Caller holds the mutex.
+ * @return callback of a request the thread had not picked up yet, to be
+ *         answered with a null move once the mutex is released
+ */
+SearchEngine::MoveCallback SearchEngine::requestSearch(MoveCallback callback) {
+  // A search still running belongs to the previous position
+  stop_flag = true;
+  MoveCallback dropped;
+  if (search_pending) dropped = std::move(pending_callback);
+  pending_callback = callback;
+  search_pending = true;
+  generation++;
+  return dropped;
+}
+
+void SearchEngine::newGame() {
+  MoveCallback dropped;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop_flag = true;
+    generation++;
+    // A request the thread has not picked up yet would search the new game
+    if (search_pending) {
+      search_pending = false;
+      dropped = std::move(pending_callback);
+    }
+    pending_callback = nullptr;
+    board.set_initial_position();
+    game_hashes.assign(1, board.get_hash());
+  }
+  if (dropped) dropped(Move());
+}
+
+void SearchEngine::setDifficult(int difficult) {
+  std::lock_guard<std::mutex> lock(mutex);
+  this->difficult = std::max(1, std::min(difficult, MAX_SEARCH_PLY - 1));
+}
+
+void SearchEngine::setMoveTime(uint32_t move_time) {
+  std::lock_guard<std::mutex> lock(mutex);
+  this->move_time = move_time;
+}
+
+void SearchEngine::stop() {
+  stop_flag = true;
+}
+
+void SearchEngine::searchLoop() {
+  while (true) {
+    MoveCallback callback;
+    uint32_t request;
+    ChessBoard position;
+    std::vector<uint64_t> hashes;
+    int max_depth;
+    uint32_t seconds;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      search_cv.wait(lock, [this] { return search_pending || !thread_running; });
+      if (!thread_running) break;
+      search_pending = false;
+      callback = pending_callback;
+      request = generation;
+      position = board;
+      hashes = game_hashes;
+      max_depth = difficult;
+      seconds = move_time;
+      // Cleared with the request taken, so a newer request or a new game
+      // always stops the search that follows
+      stop_flag = false;
+    }
+
+    Move best = searchPosition(position, std::move(hashes), max_depth, seconds);
+
+    // The game moved on (new game or newer request) meanwhile: the caller
+    // still gets an answer, a null move, so it never waits for this search
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (request != generation) best = Move();
+    }
+    if (callback) callback(best);
+  }
+}
+
+/**
+ * Iterative deepening driver
+ * @param position: position to search (modified and restored)
+ * @param hashes: keys of the game positions so far, for repetition detection
+ * @param max_depth: depth limit
+ * @param seconds: time limit
+ * @return best move of the deepest completed iteration
+ */
+Move SearchEngine::searchPosition(ChessBoard& position, std::vector<uint64_t> hashes, int max_depth,
+                                  uint32_t seconds) {
+  auto start = std::chrono::steady_clock::now();
+  deadline = start + std::chrono::seconds(std::max<uint32_t>(seconds, 1));
+  nodes = 0;
+  path_hashes = std::move(hashes);
+  std::memset(killers, 0, sizeof(killers));
+  std::memset(history, 0, sizeof(history));
+
+  MoveList root_moves;
+  position.generate_legal_moves(root_moves);
+  if (root_moves.empty()) return Move();
+  Move best = root_moves[0];
+  if (root_moves.size() == 1) return best;
+
+  for (int depth = 1; depth <= max_depth; ++depth) {
+    root_best = Move();
+    int score = negamax(position, depth, -INFINITE_SCORE, INFINITE_SCORE, 0);
+    // An interrupted iteration still counts if its best move was fully searched
+    if (!root_best.is_null()) best = root_best;
+    if (stop_flag) break;
+
+    char uci[6];
+    best.to_uci(uci);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cout << "[SRCH] depth " << depth << " score " << score << " nodes " << nodes << " time "
+              << elapsed.count() << "ms best " << uci << std::endl;
+
+    // Forced mate found, deeper iterations will not change the move
+    if (std::abs(score) >= MATE_SCORE - MAX_SEARCH_PLY) break;
+  }
+  return best;
+}
+
+bool SearchEngine::isRepetition(const ChessBoard& position) const {
+  // Only positions since the last irreversible move can repeat, same side to move
+  uint64_t key = position.get_hash();
+  int count = static_cast<int>(path_hashes.size());
+  int limit = std::max(0, count - 1 - position.get_halfmove_clock());
+  for (int i = count - 3; i >= limit; i -= 2) {
+    if (path_hashes[i] == key) return true;
+  }
+  return false;
+}
+
+int SearchEngine::negamax(ChessBoard& position, int depth, int alpha, int beta, int ply) {
+  if ((++nodes & 2047) == 0 && std::chrono::steady_clock::now() >= deadline) stop_flag = true;
+  if (stop_flag) return 0;
+
+  if (ply > 0) {
+    if (position.get_halfmove_clock() >= 100 || isRepetition(position)) return 0;
+    if (ply >= MAX_SEARCH_PLY - 1) return evaluate(position);
+  }
+
+  bool in_check = position.checkers() != 0;
+  if (in_check) depth++;
+  if (depth <= 0) return quiesce(position, alpha, beta, ply);
+
+  // Transposition table probe
+  uint64_t key = position.get_hash();
+  const TTEntry& entry = tt[key & tt_mask];
+  Move tt_move;
+  if (entry.key == key) {
+    tt_move = Move(entry.move & 0x3F, (entry.move >> 6) & 0x3F, entry.move >> 12);
+    if (ply > 0 && entry.depth >= depth) {
+      int score = entry.score;
+      if (score >= MATE_SCORE - MAX_SEARCH_PLY) score -= ply;
+      else if (score <= -MATE_SCORE + MAX_SEARCH_PLY) score += ply;
+      if (entry.bound == BOUND_EXACT) return score;
+      if (entry.bound == BOUND_LOWER && score >= beta) return score;
+      if (entry.bound == BOUND_UPPER && score <= alpha) return score;
+    }
+  }
+
+  MoveList moves;
+  position.generate_legal_moves(moves);
+  if (moves.empty()) return in_check ? -MATE_SCORE + ply : 0;
+
+  int scores[MoveList::CAPACITY];
+  orderMoves(position, moves, scores, tt_move, ply);
+
+  ChessBoard::Color us = position.get_side_to_move();
+  int original_alpha = alpha;
+  int best_score = -INFINITE_SCORE;
+  Move best_move;
+
+  for (int i = 0; i < moves.size(); ++i) {
+    // Selection sort step: pick the best remaining move
+    int best_index = i;
+    for (int j = i + 1; j < moves.size(); ++j) {
+      if (scores[j] > scores[best_index]) best_index = j;
+    }
+    std::swap(moves[i], moves[best_index]);
+    std::swap(scores[i], scores[best_index]);
+    Move move = moves[i];
+
+    position.make_move(move);
+    path_hashes.push_back(position.get_hash());
+    int score = -negamax(position, depth - 1, -beta, -alpha, ply + 1);
+    path_hashes.pop_back();
+    position.unmake_move(move);
+
+    if (stop_flag) return 0;
+
+    if (score > best_score) {
+      best_score = score;
+      best_move = move;
+      if (ply == 0) root_best = move;
+    }
+    if (score > alpha) alpha = score;
+    if (alpha >= beta) {
+      if (!move.is_capture() && !move.is_promotion()) {
+        if (killers[ply][0] != move) {
+          killers[ply][1] = killers[ply][0];
+          killers[ply][0] = move;
+        }
+        history[us][move.from()][move.to()] += depth * depth;
+      }
+      break;
+    }
+  }
+
+  Bound bound = best_score >= beta ? BOUND_LOWER : (best_score > original_alpha ? BOUND_EXACT : BOUND_UPPER);
+  storeTT(key, best_move, best_score, depth, bound, ply);
+  return best_score;
+}
+
+int SearchEngine::quiesce(ChessBoard& position, int alpha, int beta, int ply) {
+  if ((++nodes & 2047) == 0 && std::chrono::steady_clock::now() >= deadline) stop_flag = true;
+  if (stop_flag) return 0;
+
+  int stand_pat = evaluate(position);
+  if (ply >= MAX_SEARCH_PLY - 1 || stand_pat >= beta) return stand_pat;
+  if (stand_pat > alpha) alpha = stand_pat;
+
+  MoveList moves;
+  position.generate_legal_moves(moves);
+
+  // Keep captures and promotions only
+  MoveList noisy;
+  for (const Move& move : moves) {
+    if (move.is_capture() || move.is_promotion()) noisy.add(move);
+  }
+
+  int scores[MoveList::CAPACITY];
+  orderMoves(position, noisy, scores, Move(), ply);
+
+  for (int i = 0; i < noisy.size(); ++i) {
+    int best_index = i;
+    for (int j = i + 1; j < noisy.size(); ++j) {
+      if (scores[j] > scores[best_index]) best_index = j;
+    }
+    std::swap(noisy[i], noisy[best_index]);
+    std::swap(scores[i], scores[best_index]);
+    Move move = noisy[i];
+
+    position.make_move(move);
+    int score = -quiesce(position, -beta, -alpha, ply + 1);
+    position.unmake_move(move);
+
+    if (stop_flag) return 0;
+    if (score >= beta) return score;
+    if (score > alpha) alpha = score;
+  }
+  return alpha;
+}
+
+/**
+ * Static evaluation: material plus piece-square tables, with the king table
+ * tapered between middle and end game by the remaining material
+ * @return score in centipawns from the side to move's point of view
+ */
+int SearchEngine::evaluate(const ChessBoard& position) const {
+  int score = 0;
+  int phase = 0;
+  int king_middle = 0;
+  int king_end = 0;
+
+  for (int color = ChessBoard::WHITE; color <= ChessBoard::BLACK; ++color) {
+    int sign = (color == ChessBoard::WHITE) ? 1 : -1;
+    int flip = (color == ChessBoard::WHITE) ? 56 : 0;
+
+    for (int piece = ChessBoard::PAWN; piece <= ChessBoard::QUEEN; ++piece) {
+      ChessBoard::Bitboard bb =
+          position.get_pieces(static_cast<ChessBoard::Piece>(piece), static_cast<ChessBoard::Color>(color));
+      while (bb) {
+        int square = __builtin_ctzll(bb);
+        score += sign * (PIECE_VALUES[piece] + PIECE_TABLES[piece][square ^ flip]);
+        phase += PHASE_WEIGHTS[piece];
+        bb &= bb - 1;
+      }
+    }
+
+    ChessBoard::Bitboard king = position.get_pieces(ChessBoard::KING, static_cast<ChessBoard::Color>(color));
+    if (king) {
+      int square = __builtin_ctzll(king);
+      king_middle += sign * KING_MIDDLE_TABLE[square ^ flip];
+      king_end += sign * KING_END_TABLE[square ^ flip];
+    }
+  }
+
+  phase = std::min(phase, MAX_PHASE);
+  score += (king_middle * phase + king_end * (MAX_PHASE - phase)) / MAX_PHASE;
+  return position.get_side_to_move() == ChessBoard::WHITE ? score : -score;
+}
+
+/**
+ * Score moves for ordering: TT move, captures by MVV-LVA, killers, history
+ */
+void SearchEngine::orderMoves(const ChessBoard& position, MoveList& moves, int* scores, Move tt_move,
+                              int ply) const {
+  ChessBoard::Color us = position.get_side_to_move();
+  for (int i = 0; i < moves.size(); ++i) {
+    Move move = moves[i];
+    if (move == tt_move) {
+      scores[i] = 1000000;
+    } else if (move.is_capture()) {
+      ChessBoard::Piece victim =
+          move.is_en_passant() ? ChessBoard::PAWN : position.get_piece_at(static_cast<ChessBoard::Square>(move.to()));
+      ChessBoard::Piece attacker = position.get_piece_at(static_cast<ChessBoard::Square>(move.from()));
+      scores[i] = 100000 + PIECE_VALUES[victim] * 10 - PIECE_VALUES[attacker] / 10;
+    } else if (move.is_promotion()) {
+      scores[i] = 95000 + move.promotion_piece();
+    } else if (move == killers[ply][0]) {
+      scores[i] = 90000;
+    } else if (move == killers[ply][1]) {
+      scores[i] = 80000;
+    } else {
+      scores[i] = std::min(history[us][move.from()][move.to()], 70000);
+    }
+  }
+}
+
+void SearchEngine::storeTT(uint64_t key, Move move, int score, int depth, Bound bound, int ply) {
+  TTEntry& entry = tt[key & tt_mask];
+  // Keep deeper results for the same position
+  if (entry.key == key && entry.depth > depth && bound != BOUND_EXACT) return;
+
+  // Mate scores are stored relative to this node, not the root
+  if (score >= MATE_SCORE - MAX_SEARCH_PLY) score += ply;
+  else if (score <= -MATE_SCORE + MAX_SEARCH_PLY) score -= ply;
+
+  entry.key = key;
+  entry.move = move.raw();
+  entry.score = static_cast<int16_t>(score);
+  entry.depth = static_cast<int8_t>(depth);
+  entry.bound = bound;
+}
@@ -0,0 +1,104 @@
+#ifndef SEARCH_ENGINE_H
+#define SEARCH_ENGINE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bitboard.h"
+
+/**
+ * Built-in engine, an in-process alternative to the gnuchess subprocess.
+ * Iterative deepening alpha-beta with quiescence search, a transposition
+ * table and TT/MVV-LVA/killer/history move ordering, all on ChessBoard.
+ *
+ * The public interface mirrors UCIEngine: sendMoveAsync appends a move,
+ * sendPositionAsync starts over from a position, and the best move is
+ * delivered through the callback from the search thread. Every request gets
+ * exactly one answer: a null move when there is no legal move or when a new
+ * game or a newer request made the search obsolete.
+ */
+class SearchEngine {
+public:
+    using MoveCallback = std::function<void(Move move)>;
+
+    SearchEngine(size_t hash_mb = DEFAULT_HASH_MB);
+    ~SearchEngine();
+
+    SearchEngine(const SearchEngine&) = delete;
+    SearchEngine& operator=(const SearchEngine&) = delete;
+
+    // Same call pattern as UCIEngine
+    void sendMoveAsync(Move move, MoveCallback callback = nullptr);
+    void sendPositionAsync(const ChessBoard& position, MoveCallback callback = nullptr);
+    void addMoveToHistory(Move move);
+    void newGame();
+    void setDifficult(int difficult);
+    void setMoveTime(uint32_t move_time);
+    void stop();
+
+    static constexpr size_t DEFAULT_HASH_MB = 4;
+
+private:
+    // Transposition table entry, 16 bytes
+    struct TTEntry {
+        uint64_t key;
+        uint16_t move;
+        int16_t score;
+        int8_t depth;
+        uint8_t bound;
+    };
+    enum Bound : uint8_t { BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT };
+
+    static constexpr int MAX_SEARCH_PLY = 64;
+    static constexpr int INFINITE_SCORE = 32000;
+    static constexpr int MATE_SCORE = 31000;
+
+    // Game position, guarded by mutex
+    ChessBoard board;
+    std::vector<uint64_t> game_hashes;
+    std::mutex mutex;
+
+    // Limits
+    int difficult = 1;           // maximum depth
+    uint32_t move_time = 2;      // seconds
+
+    // Worker thread
+    std::unique_ptr<std::thread> search_thread;
+    std::condition_variable search_cv;
+    bool search_pending = false;
+    bool thread_running = true;
+    uint32_t generation = 0;  // bumped by every request and new game
+    MoveCallback pending_callback;
+
+    // Search state, only touched by the searching thread
+    std::vector<TTEntry> tt;
+    uint64_t tt_mask = 0;
+    std::vector<uint64_t> path_hashes;
+    Move root_best;
+    Move killers[MAX_SEARCH_PLY][2];
+    int history[2][64][64];
+    uint64_t nodes = 0;
+    std::chrono::steady_clock::time_point deadline;
+    std::atomic<bool> stop_flag{false};
+
+    void searchLoop();
+    void playMove(Move move);
+    MoveCallback requestSearch(MoveCallback callback);
+    Move searchPosition(ChessBoard& position, std::vector<uint64_t> hashes, int max_depth, uint32_t seconds);
+    int negamax(ChessBoard& position, int depth, int alpha, int beta, int ply);
+    int quiesce(ChessBoard& position, int alpha, int beta, int ply);
+    int evaluate(const ChessBoard& position) const;
+    void orderMoves(const ChessBoard& position, MoveList& moves, int* scores, Move tt_move, int ply) const;
+    bool isRepetition(const ChessBoard& position) const;
+    void storeTT(uint64_t key, Move move, int score, int depth, Bound bound, int ply);
+};
+
+#endif // SEARCH_ENGINE_H
@@ -0,0 +1,907 @@
+#include "syzygy_tablebase.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+using Bitboard = ChessBoard::Bitboard;
+
+namespace {
+
+const uint8_t WDL_MAGIC[4] = {0x71, 0xE8, 0x23, 0x5D};
+const uint8_t DTZ_MAGIC[4] = {0xD7, 0x66, 0x0C, 0xA5};
+
+// Per table flags stored in the file
+enum TableFlag { FLAG_STM = 1, FLAG_MAPPED = 2, FLAG_WIN_PLIES = 4, FLAG_LOSS_PLIES = 8, FLAG_WIDE = 16, FLAG_SINGLE_VALUE = 128 };
+
+// Result of a probe: CHANGE_STM when a DTZ table only holds the other side to
+// move, ZEROING when the best move is a capture or pawn move whose value the
+// tables do not store
+enum ProbeState { PROBE_FAIL = 0, PROBE_OK = 1, PROBE_CHANGE_STM = -1, PROBE_ZEROING = 2 };
+
+constexpr int MAX_PIECES = SyzygyTablebase::MAX_PIECES;
+constexpr int PAWN_CODE = 1;
+constexpr int BLACK_CODE = 8;
+
+/**
+ * Decoding state of one sub-table (one side to move, one leading pawn file).
+ * Positions are indexed by a combinatorial encoding of piece groups and the
+ * values are stored as blocks of canonical Huffman codes over symbols that
+ * recursively expand into pairs of symbols.
+ */
+struct PairsData {
+  uint8_t flags = 0;
+  size_t block_size = 0;
+  size_t span = 0;                          // positions between two sparse index entries
+  uint32_t num_blocks = 0;
+  int max_sym_len = 0;
+  int min_sym_len = 0;                      // or the value itself with FLAG_SINGLE_VALUE
+  const uint8_t* lowest_sym = nullptr;      // lowest symbol of each code length (uint16 LE)
+  const uint8_t* btree = nullptr;           // 12-bit left and right child of each symbol
+  const uint8_t* block_length = nullptr;    // positions per block minus one (uint16 LE)
+  size_t block_length_size = 0;
+  const uint8_t* sparse_index = nullptr;    // block (uint32 LE) and offset (uint16 LE)
+  size_t sparse_index_size = 0;
+  const uint8_t* data = nullptr;            // compressed blocks
+  std::vector<uint64_t> base64;             // lowest code of each length, left aligned
+  std::vector<uint8_t> symlen;              // values represented by each symbol, minus one
+  uint8_t pieces[MAX_PIECES] = {};          // piece codes in encoding order
+  uint64_t group_idx[MAX_PIECES + 1] = {};
+  int group_len[MAX_PIECES + 1] = {};
+  uint16_t map_idx[4] = {};                 // DTZ value maps per WDL result
+};
+
+// Encoding tables, shared by every table
+int map_b1h1h7[64];
+int map_a1d1d4[64];
+int map_kk[10][64];
+uint64_t binomial[MAX_PIECES][64];
+int map_pawns[64];
+int lead_pawn_idx[MAX_PIECES][64];
+int lead_pawns_size[MAX_PIECES][4];
+
+int file_of(int square) { return square & 7; }
+int rank_of(int square) { return square >> 3; }
+int off_a1h8(int square) { return rank_of(square) - file_of(square); }
+int sign_of(int value) { return (value > 0) - (value < 0); }
+
+template <typename T>
+T read_le(const uint8_t* data) {
+  T value = 0;
+  for (size_t i = 0; i < sizeof(T); i++) value |= static_cast<T>(data[i]) << (8 * i);
+  return value;
+}
+
+template <typename T>
+T read_be(const uint8_t* data) {
+  T value = 0;
+  for (size_t i = 0; i < sizeof(T); i++) value = static_cast<T>((value << 8) | data[i]);
+  return value;
+}
+
+void init_encoding() {
+  // b1-h1-h7 triangle, squares below the a1-h8 diagonal, to 0..27
+  int code = 0;
+  for (int square = 0; square < 64; square++) {
+    if (off_a1h8(square) < 0) map_b1h1h7[square] = code++;
+  }
+
+  // a1-d1-d4 triangle to 0..9, the diagonal squares last
+  std::vector<int> diagonal;
+  code = 0;
+  for (int square = ChessBoard::A1; square <= ChessBoard::D4; square++) {
+    if (off_a1h8(square) < 0 && file_of(square) <= 3) map_a1d1d4[square] = code++;
+    else if (off_a1h8(square) == 0 && file_of(square) <= 3) diagonal.push_back(square);
+  }
+  for (int square : diagonal) map_a1d1d4[square] = code++;
+
+  // The 462 legal placements of two kings with the first one in the a1-d1-d4
+  // triangle; with the first on the diagonal the second is not above it
+  std::vector<std::pair<int, int>> both_on_diagonal;
+  code = 0;
+  for (int idx = 0; idx < 10; idx++) {
+    for (int s1 = ChessBoard::A1; s1 <= ChessBoard::D4; s1++) {
+      if (map_a1d1d4[s1] != idx || (idx == 0 && s1 != ChessBoard::B1)) continue;
+      for (int s2 = 0; s2 < 64; s2++) {
+        if (std::abs(file_of(s1) - file_of(s2)) <= 1 && std::abs(rank_of(s1) - rank_of(s2)) <= 1) continue;
+        if (off_a1h8(s1) == 0 && off_a1h8(s2) > 0) continue;
+        if (off_a1h8(s1) == 0 && off_a1h8(s2) == 0) both_on_diagonal.emplace_back(idx, s2);
+        else map_kk[idx][s2] = code++;
+      }
+    }
+  }
+  for (const auto& [idx, square] : both_on_diagonal) map_kk[idx][square] = code++;
+
+  // binomial[k][n]: ways to choose k squares out of n
+  binomial[0][0] = 1;
+  for (int n = 1; n < 64; n++) {
+    for (int k = 0; k < MAX_PIECES && k <= n; k++) {
+      binomial[k][n] = (k > 0 ? binomial[k - 1][n - 1] : 0) + (k < n ? binomial[k][n - 1] : 0);
+    }
+  }
+
+  // Pawn squares a2-h7 to 47..0, the leading pawn has the highest value: the
+  // one nearest the edge and, on the same file, the lowest rank
+  int available = 47;
+  for (int lead_count = 1; lead_count <= 5; lead_count++) {
+    for (int file = 0; file < 4; file++) {
+      int idx = 0;
+      for (int rank = 1; rank <= 6; rank++) {
+        int square = rank * 8 + file;
+        if (lead_count == 1) {
+          map_pawns[square] = available--;
+          map_pawns[square ^ 7] = available--;
+        }
+        lead_pawn_idx[lead_count][square] = idx;
+        idx += binomial[lead_count - 1][map_pawns[square]];
+      }
+      lead_pawns_size[lead_count][file] = idx;
+    }
+  }
+}
+
+bool pawns_before(int a, int b) { return map_pawns[a] < map_pawns[b]; }
+
+int btree_left(const PairsData& d, int sym) {
+  const uint8_t* node = d.btree + 3 * sym;
+  return ((node[1] & 0xF) << 8) | node[0];
+}
+
+int btree_right(const PairsData& d, int sym) {
+  const uint8_t* node = d.btree + 3 * sym;
+  return (node[2] << 4) | (node[1] >> 4);
+}
+
+int set_symlen(PairsData& d, int sym, std::vector<bool>& visited) {
+  visited[sym] = true;
+  int right = btree_right(d, sym);
+  if (right == 0xFFF) return 0;
+
+  int left = btree_left(d, sym);
+  if (!visited[left]) d.symlen[left] = set_symlen(d, left, visited);
+  if (!visited[right]) d.symlen[right] = set_symlen(d, right, visited);
+  return d.symlen[left] + d.symlen[right] + 1;
+}
+
+// Read the Huffman tables of a sub-table, return the end of its header
+const uint8_t* set_sizes(PairsData& d, const uint8_t* data) {
+  d.flags = *data++;
+  if (d.flags & FLAG_SINGLE_VALUE) {
+    d.min_sym_len = *data++;
+    return data;
+  }
+
+  // group_len is zero terminated, the group_idx after the last group is the table size
+  int groups = static_cast<int>(std::find(d.group_len, d.group_len + MAX_PIECES, 0) - d.group_len);
+  uint64_t table_size = d.group_idx[groups];
+
+  d.block_size = size_t(1) << *data++;
+  d.span = size_t(1) << *data++;
+  d.sparse_index_size = static_cast<size_t>((table_size + d.span - 1) / d.span);
+  int padding = *data++;
+  d.num_blocks = read_le<uint32_t>(data);
+  data += 4;
+  d.block_length_size = d.num_blocks + padding;
+  d.max_sym_len = *data++;
+  d.min_sym_len = *data++;
+  d.lowest_sym = data;
+  if (d.max_sym_len < d.min_sym_len || d.max_sym_len > 32) return nullptr;
+  d.base64.assign(d.max_sym_len - d.min_sym_len + 1, 0);
+
+  // Longer codes have lower values, so base64 decreases with the length
+  for (int i = static_cast<int>(d.base64.size()) - 2; i >= 0; i--) {
+    d.base64[i] = (d.base64[i + 1] + read_le<uint16_t>(d.lowest_sym + 2 * i) -
+                   read_le<uint16_t>(d.lowest_sym + 2 * (i + 1))) / 2;
+  }
+  for (size_t i = 0; i < d.base64.size(); i++) d.base64[i] <<= 64 - i - d.min_sym_len;
+
+  data += d.base64.size() * 2;
+  d.symlen.assign(read_le<uint16_t>(data), 0);
+  data += 2;
+  d.btree = data;
+
+  std::vector<bool> visited(d.symlen.size());
+  for (size_t sym = 0; sym < d.symlen.size(); sym++) {
+    if (!visited[sym]) d.symlen[sym] = set_symlen(d, static_cast<int>(sym), visited);
+  }
+  return data + d.symlen.size() * 3 + (d.symlen.size() & 1);
+}
+
+// Value stored at position index idx of a sub-table
+int decompress_pairs(const PairsData& d, uint64_t idx) {
+  if (d.flags & FLAG_SINGLE_VALUE) return d.min_sym_len;
+
+  // The sparse index points near idx, walk the block lengths to the block holding it
+  uint32_t k = static_cast<uint32_t>(idx / d.span);
+  uint32_t block = read_le<uint32_t>(d.sparse_index + 6 * k);
+  int offset = read_le<uint16_t>(d.sparse_index + 6 * k + 4);
+  offset += static_cast<int>(idx % d.span) - static_cast<int>(d.span / 2);
+
+  while (offset < 0) offset += read_le<uint16_t>(d.block_length + 2 * --block) + 1;
+  while (offset > read_le<uint16_t>(d.block_length + 2 * block)) {
+    offset -= read_le<uint16_t>(d.block_length + 2 * block++) + 1;
+  }
+
+  // Skip whole symbols of the block until the one covering offset
+  const uint8_t* ptr = d.data + static_cast<uint64_t>(block) * d.block_size;
+  uint64_t buf64 = read_be<uint64_t>(ptr);
+  ptr += 8;
+  int buf64_size = 64;
+  int sym;
+
+  while (true) {
+    int len = 0;
+    while (buf64 < d.base64[len]) len++;
+    sym = static_cast<int>((buf64 - d.base64[len]) >> (64 - len - d.min_sym_len));
+    sym += read_le<uint16_t>(d.lowest_sym + 2 * len);
+
+    if (offset < d.symlen[sym] + 1) break;
+    offset -= d.symlen[sym] + 1;
+    len += d.min_sym_len;
+    buf64 <<= len;
+    buf64_size -= len;
+    if (buf64_size <= 32) {
+      buf64_size += 32;
+      buf64 |= static_cast<uint64_t>(read_be<uint32_t>(ptr)) << (64 - buf64_size);
+      ptr += 4;
+    }
+  }
+
+  // Expand the pair tree down to the single value at offset
+  while (d.symlen[sym]) {
+    int left = btree_left(d, sym);
+    if (offset < d.symlen[left] + 1) {
+      sym = left;
+    } else {
+      offset -= d.symlen[left] + 1;
+      sym = btree_right(d, sym);
+    }
+  }
+  return btree_left(d, sym);
+}
+
+}  // namespace
+
+/**
+ * One .rtbw or .rtbz file. The material code of the file name puts its first
+ * side as white ("KQvKR"); positions with the colors reversed are probed with
+ * the board flipped.
+ */
+struct SyzygyTable {
+  std::string path;
+  bool dtz = false;
+  bool ready = false;    // mapped and parsed
+  bool failed = false;   // missing or corrupt, never retried
+  const uint8_t* base = nullptr;
+  size_t size = 0;
+
+  int piece_count = 0;
+  bool has_pawns = false;
+  bool has_unique_pieces = false;
+  bool symmetric = false;     // same material on both sides, white to move only
+  int pawn_count[2] = {};     // leading color first
+  PairsData items[2][4];      // [side to move][leading pawn file]
+  const uint8_t* dtz_map = nullptr;
+
+  SyzygyTable(const std::string& code, const std::string& file_path, bool is_dtz) : path(file_path), dtz(is_dtz) {
+    size_t split = code.find('v');
+    int counts[2][6] = {};
+    for (size_t i = 0; i < code.size(); i++) {
+      if (i == split) continue;
+      int piece = static_cast<int>(std::string("PNBRQK").find(code[i]));
+      counts[i < split ? 0 : 1][piece]++;
+      piece_count++;
+    }
+    has_pawns = counts[0][ChessBoard::PAWN] + counts[1][ChessBoard::PAWN] > 0;
+    for (int color = 0; color < 2; color++) {
+      for (int piece = ChessBoard::PAWN; piece < ChessBoard::KING; piece++) {
+        if (counts[color][piece] == 1) has_unique_pieces = true;
+      }
+    }
+    symmetric = code.substr(0, split) == code.substr(split + 1);
+
+    // With pawns on both sides the side with fewer pawns leads
+    int white_pawns = counts[0][ChessBoard::PAWN];
+    int black_pawns = counts[1][ChessBoard::PAWN];
+    bool white_leads = !black_pawns || (white_pawns && black_pawns >= white_pawns);
+    pawn_count[0] = white_leads ? white_pawns : black_pawns;
+    pawn_count[1] = white_leads ? black_pawns : white_pawns;
+  }
+
+  ~SyzygyTable() {
+    if (base) munmap(const_cast<uint8_t*>(base), size);
+  }
+
+  PairsData* get(int stm, int file) { return &items[dtz ? 0 : stm][has_pawns ? file : 0]; }
+
+  bool map();
+  const uint8_t* parse(const uint8_t* data);
+  void set_groups(PairsData& d, const int order[2], int file);
+  const uint8_t* set_dtz_map(const uint8_t* data, int max_file);
+  int map_score(int file, int value, int wdl);
+};
+
+bool SyzygyTable::map() {
+  failed = true;
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "[SYZY] Could not open tablebase: " << path << std::endl;
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size % 64 != 16) {
+    std::cerr << "[SYZY] Corrupt tablebase file: " << path << std::endl;
+    ::close(fd);
+    return false;
+  }
+
+  void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    std::cerr << "[SYZY] Could not map tablebase: " << path << std::endl;
+    return false;
+  }
+  // Probes jump around the file, read ahead would only grow the resident set
+  madvise(data, info.st_size, MADV_RANDOM);
+  base = static_cast<const uint8_t*>(data);
+  size = info.st_size;
+
+  const uint8_t* magic = dtz ? DTZ_MAGIC : WDL_MAGIC;
+  if (!std::equal(magic, magic + 4, base)) {
+    std::cerr << "[SYZY] Not a Syzygy " << (dtz ? "DTZ" : "WDL") << " file: " << path << std::endl;
+    return false;
+  }
+
+  const uint8_t* end = parse(base + 4);
+  if (!end || end > base + size) {
+    std::cerr << "[SYZY] Corrupt tablebase file: " << path << std::endl;
+    return false;
+  }
+
+  failed = false;
+  ready = true;
+  return true;
+}
+
+// Layout of the groups a position index is made of, see probe_table
+void SyzygyTable::set_groups(PairsData& d, const int order[2], int file) {
+  int n = 0;
+  int first_len = has_pawns ? 0 : has_unique_pieces ? 3 : 2;
+  d.group_len[n] = 1;
+
+  // The leading group holds the kings (or three unique pieces, or the leading
+  // pawns), then one group per run of equal pieces: KRvKN is (3, 1)
+  for (int i = 1; i < piece_count; i++) {
+    if (--first_len > 0 || d.pieces[i] == d.pieces[i - 1]) d.group_len[n]++;
+    else d.group_len[++n] = 1;
+  }
+  d.group_len[++n] = 0;
+
+  // Groups are combined in a per-table order: the leading group at order[0],
+  // the remaining pawns, if any, at order[1]
+  bool pawns_both_sides = has_pawns && pawn_count[1];
+  int next = pawns_both_sides ? 2 : 1;
+  int free_squares = 64 - d.group_len[0] - (pawns_both_sides ? d.group_len[1] : 0);
+  uint64_t idx = 1;
+
+  for (int k = 0; next < n || k == order[0] || k == order[1]; k++) {
+    if (k == order[0]) {
+      d.group_idx[0] = idx;
+      idx *= has_pawns ? lead_pawns_size[d.group_len[0]][file] : has_unique_pieces ? 31332 : 462;
+    } else if (k == order[1]) {
+      d.group_idx[1] = idx;
+      idx *= binomial[d.group_len[1]][48 - d.group_len[0]];
+    } else {
+      d.group_idx[next] = idx;
+      idx *= binomial[d.group_len[next]][free_squares];
+      free_squares -= d.group_len[next++];
+    }
+  }
+  d.group_idx[n] = idx;
+}
+
+const uint8_t* SyzygyTable::set_dtz_map(const uint8_t* data, int max_file) {
+  if (!dtz) return data;
+  dtz_map = data;
+
+  for (int file = 0; file <= max_file; file++) {
+    PairsData* d = get(0, file);
+    if (!(d->flags & FLAG_MAPPED)) continue;
+    if (d->flags & FLAG_WIDE) {
+      data += (data - base) & 1;
+      for (int i = 0; i < 4; i++) {
+        d->map_idx[i] = static_cast<uint16_t>((data - dtz_map) / 2 + 1);
+        data += 2 * read_le<uint16_t>(data) + 2;
+      }
+    } else {
+      for (int i = 0; i < 4; i++) {
+        d->map_idx[i] = static_cast<uint16_t>(data - dtz_map + 1);
+        data += *data + 1;
+      }
+    }
+  }
+  return data + ((data - base) & 1);
+}
+
+const uint8_t* SyzygyTable::parse(const uint8_t* data) {
+  constexpr int HAS_PAWNS = 2;
+  if (bool(*data & HAS_PAWNS) != has_pawns) return nullptr;
+  data++;
+
+  int sides = !dtz && !symmetric ? 2 : 1;
+  int max_file = has_pawns ? 3 : 0;
+  bool pawns_both_sides = has_pawns && pawn_count[1];
+
+  for (int file = 0; file <= max_file; file++) {
+    int order[2][2] = {{*data & 0xF, pawns_both_sides ? *(data + 1) & 0xF : 0xF},
+                       {*data >> 4, pawns_both_sides ? *(data + 1) >> 4 : 0xF}};
+    data += 1 + pawns_both_sides;
+
+    for (int k = 0; k < piece_count; k++, data++) {
+      for (int i = 0; i < sides; i++) items[i][file].pieces[k] = i ? *data >> 4 : *data & 0xF;
+    }
+    for (int i = 0; i < sides; i++) set_groups(items[i][file], order[i], file);
+  }
+  data += (data - base) & 1;
+
+  for (int file = 0; file <= max_file; file++) {
+    for (int i = 0; i < sides; i++) {
+      data = set_sizes(items[i][file], data);
+      if (!data) return nullptr;
+    }
+  }
+
+  data = set_dtz_map(data, max_file);
+
+  for (int file = 0; file <= max_file; file++) {
+    for (int i = 0; i < sides; i++) {
+      items[i][file].sparse_index = data;
+      data += items[i][file].sparse_index_size * 6;
+    }
+  }
+  for (int file = 0; file <= max_file; file++) {
+    for (int i = 0; i < sides; i++) {
+      items[i][file].block_length = data;
+      data += items[i][file].block_length_size * 2;
+    }
+  }
+  for (int file = 0; file <= max_file; file++) {
+    for (int i = 0; i < sides; i++) {
+      data = base + (((data - base) + 0x3F) & ~0x3F);
+      items[i][file].data = data;
+      data += static_cast<size_t>(items[i][file].num_blocks) * items[i][file].block_size;
+    }
+  }
+  return data;
+}
+
+// DTZ values are stored remapped per WDL result and in moves or plies
+int SyzygyTable::map_score(int file, int value, int wdl) {
+  if (!dtz) return value - 2;
+
+  static const int WDL_MAP[] = {1, 3, 0, 2, 0};
+  PairsData* d = get(0, file);
+  if (d->flags & FLAG_MAPPED) {
+    int slot = d->map_idx[WDL_MAP[wdl + 2]] + value;
+    value = (d->flags & FLAG_WIDE) ? read_le<uint16_t>(dtz_map + 2 * slot) : dtz_map[slot];
+  }
+
+  if ((wdl == SyzygyTablebase::WIN && !(d->flags & FLAG_WIN_PLIES)) ||
+      (wdl == SyzygyTablebase::LOSS && !(d->flags & FLAG_LOSS_PLIES)) ||
+      wdl == SyzygyTablebase::CURSED_WIN || wdl == SyzygyTablebase::BLESSED_LOSS) {
+    value *= 2;
+  }
+  return value + 1;
+}
+
+namespace {
+
+// Piece code used by the table files: 1..6 pawn..king, +8 for black
+int piece_code(const ChessBoard& board, int square) {
+  auto sq = static_cast<ChessBoard::Square>(square);
+  return (board.get_piece_at(sq) + 1) | (board.get_color_at(sq) == ChessBoard::BLACK ? BLACK_CODE : 0);
+}
+
+/**
+ * Turn the position into its sub-table and index. The board is mirrored so
+ * the stronger side is white and the leading piece sits in the a1-d1-d4
+ * triangle (or the leading pawn on files a-d), then each group of pieces is
+ * encoded as a combination of its free squares.
+ * @return nullptr with state set when the table can not answer
+ */
+PairsData* encode_position(SyzygyTable& table, const ChessBoard& board, bool black_stronger, int& tb_file,
+                           uint64_t& idx, int& state) {
+  int squares[MAX_PIECES];
+  int pieces[MAX_PIECES];
+  int size = 0;
+  int lead_pawns_count = 0;
+  Bitboard lead_pawns = 0;
+  tb_file = 0;
+
+  bool black_to_move = board.get_side_to_move() == ChessBoard::BLACK;
+  bool flip = (table.symmetric && black_to_move) || black_stronger;
+  int flip_color = flip ? BLACK_CODE : 0;
+  int flip_squares = flip ? 56 : 0;
+  int stm = flip ^ black_to_move;
+
+  if (table.has_pawns) {
+    int lead = table.get(0, 0)->pieces[0] ^ flip_color;
+    if ((lead & 7) != PAWN_CODE) return state = PROBE_FAIL, nullptr;
+    auto lead_color = (lead & BLACK_CODE) ? ChessBoard::BLACK : ChessBoard::WHITE;
+    lead_pawns = board.get_pieces(ChessBoard::PAWN, lead_color);
+    for (Bitboard b = lead_pawns; b; b &= b - 1) squares[size++] = __builtin_ctzll(b) ^ flip_squares;
+    lead_pawns_count = size;
+
+    std::swap(squares[0], *std::max_element(squares, squares + lead_pawns_count, pawns_before));
+    tb_file = file_of(squares[0]);
+    if (tb_file > 3) tb_file = file_of(squares[0] ^ 7);
+  }
+
+  PairsData* d = table.get(stm, tb_file);
+  if (table.dtz && (d->flags & FLAG_STM) != stm && !(table.symmetric && !table.has_pawns)) {
+    return state = PROBE_CHANGE_STM, nullptr;
+  }
+
+  for (Bitboard b = board.get_occupancy(ChessBoard::BOTH) ^ lead_pawns; b; b &= b - 1) {
+    int square = __builtin_ctzll(b);
+    squares[size] = square ^ flip_squares;
+    pieces[size++] = piece_code(board, square) ^ flip_color;
+  }
+
+  // Order the pieces like the table does
+  for (int i = lead_pawns_count; i < size - 1; i++) {
+    for (int j = i + 1; j < size; j++) {
+      if (d->pieces[i] == pieces[j]) {
+        std::swap(pieces[i], pieces[j]);
+        std::swap(squares[i], squares[j]);
+        break;
+      }
+    }
+  }
+
+  if (file_of(squares[0]) > 3) {
+    for (int i = 0; i < size; i++) squares[i] ^= 7;
+  }
+
+  if (table.has_pawns) {
+    idx = lead_pawn_idx[lead_pawns_count][squares[0]];
+    std::stable_sort(squares + 1, squares + lead_pawns_count, pawns_before);
+    for (int i = 1; i < lead_pawns_count; i++) idx += binomial[i][map_pawns[squares[i]]];
+  } else {
+    if (rank_of(squares[0]) > 3) {
+      for (int i = 0; i < size; i++) squares[i] ^= 56;
+    }
+
+    // The first leading piece off the a1-h8 diagonal goes below it
+    for (int i = 0; i < d->group_len[0]; i++) {
+      if (!off_a1h8(squares[i])) continue;
+      if (off_a1h8(squares[i]) > 0) {
+        for (int j = i; j < size; j++) squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+      }
+      break;
+    }
+
+    if (table.has_unique_pieces) {
+      int adjust1 = squares[1] > squares[0];
+      int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+
+      if (off_a1h8(squares[0])) {
+        idx = (map_a1d1d4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+      } else if (off_a1h8(squares[1])) {
+        idx = (6 * 63 + rank_of(squares[0]) * 28 + map_b1h1h7[squares[1]]) * 62 + squares[2] - adjust2;
+      } else if (off_a1h8(squares[2])) {
+        idx = 6 * 63 * 62 + 4 * 28 * 62 + rank_of(squares[0]) * 7 * 28 +
+              (rank_of(squares[1]) - adjust1) * 28 + map_b1h1h7[squares[2]];
+      } else {
+        idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + rank_of(squares[0]) * 7 * 6 +
+              (rank_of(squares[1]) - adjust1) * 6 + (rank_of(squares[2]) - adjust2);
+      }
+    } else {
+      idx = map_kk[map_a1d1d4[squares[0]]][squares[1]];
+    }
+  }
+
+  // Remaining groups, each square counted among the squares not taken by earlier groups
+  idx *= d->group_idx[0];
+  int* group = squares + d->group_len[0];
+  bool remaining_pawns = table.has_pawns && table.pawn_count[1];
+  for (int next = 1; d->group_len[next]; next++) {
+    std::stable_sort(group, group + d->group_len[next]);
+    uint64_t n = 0;
+    for (int i = 0; i < d->group_len[next]; i++) {
+      int adjust = static_cast<int>(std::count_if(squares, group, [&](int square) { return group[i] > square; }));
+      n += binomial[i + 1][group[i] - adjust - 8 * remaining_pawns];
+    }
+    remaining_pawns = false;
+    idx += n * d->group_idx[next];
+    group += d->group_len[next];
+  }
+  return d;
+}
+
+int probe_table(SyzygyTable& table, const ChessBoard& board, bool black_stronger, int wdl, int& state) {
+  int tb_file;
+  uint64_t idx;
+  PairsData* d = encode_position(table, board, black_stronger, tb_file, idx, state);
+  if (!d) return 0;
+  return table.map_score(tb_file, decompress_pairs(*d, idx), wdl);
+}
+
+std::string material_code(const ChessBoard& board, ChessBoard::Color first) {
+  std::string code;
+  for (ChessBoard::Color color : {first, first == ChessBoard::WHITE ? ChessBoard::BLACK : ChessBoard::WHITE}) {
+    if (!code.empty()) code += 'v';
+    for (ChessBoard::Piece piece : {ChessBoard::KING, ChessBoard::QUEEN, ChessBoard::ROOK, ChessBoard::BISHOP,
+                                    ChessBoard::KNIGHT, ChessBoard::PAWN}) {
+      code.append(__builtin_popcountll(board.get_pieces(piece, color)), "PNBRQK"[piece]);
+    }
+  }
+  return code;
+}
+
+// DTZ of a capture or pawn move from its WDL result
+int dtz_before_zeroing(int wdl) {
+  switch (wdl) {
+    case SyzygyTablebase::WIN: return 1;
+    case SyzygyTablebase::CURSED_WIN: return 101;
+    case SyzygyTablebase::BLESSED_LOSS: return -101;
+    case SyzygyTablebase::LOSS: return -1;
+    default: return 0;
+  }
+}
+
+bool is_zeroing(const ChessBoard& board, Move move) {
+  return move.is_capture() || board.get_piece_at(static_cast<ChessBoard::Square>(move.from())) == ChessBoard::PAWN;
+}
+
+bool is_mate(const ChessBoard& board) {
+  if (!board.checkers()) return false;
+  MoveList moves;
+  board.generate_legal_moves(moves);
+  return moves.empty();
+}
+
+}  // namespace
+
+SyzygyTablebase::SyzygyTablebase() = default;
+SyzygyTablebase::~SyzygyTablebase() = default;
+
+bool SyzygyTablebase::init(const std::string& paths) {
+  static std::once_flag encoding_ready;
+  std::call_once(encoding_ready, init_encoding);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  files.clear();
+  tables.clear();
+  max_pieces = 0;
+
+  std::stringstream stream(paths);
+  std::string directory;
+  const char* home_dir = std::getenv("HOME");
+  while (std::getline(stream, directory, ':')) {
+    if (directory.rfind("~/", 0) == 0 && home_dir) directory = std::string(home_dir) + directory.substr(1);
+
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+      std::string extension = entry.path().extension().string();
+      if (extension != ".rtbw" && extension != ".rtbz") continue;
+
+      // Material code like KQvKR: both sides with a king, at most MAX_PIECES pieces
+      std::string code = entry.path().stem().string();
+      size_t split = code.find('v');
+      if (split == std::string::npos || code.size() - 1 > MAX_PIECES || code[0] != 'K' ||
+          split + 1 >= code.size() || code[split + 1] != 'K' ||
+          code.find_first_not_of("KQRBNPv") != std::string::npos ||
+          std::count(code.begin(), code.end(), 'K') != 2) {
+        continue;
+      }
+
+      // The first directory listing a table wins
+      files.emplace(entry.path().filename().string(), entry.path().string());
+      max_pieces = std::max(max_pieces, static_cast<int>(code.size()) - 1);
+    }
+    if (error) std::cerr << "[SYZY] Could not read tablebase directory: " << directory << std::endl;
+  }
+
+  std::cout << "[SYZY] Found " << files.size() << " tablebase files, up to " << max_pieces << " pieces"
+            << std::endl;
+  return !files.empty();
+}
+
+bool SyzygyTablebase::covers(const ChessBoard& board) const {
+  return __builtin_popcountll(board.get_occupancy(ChessBoard::BOTH)) <= max_pieces &&
+         !board.can_castle(ChessBoard::WHITE, true) && !board.can_castle(ChessBoard::WHITE, false) &&
+         !board.can_castle(ChessBoard::BLACK, true) && !board.can_castle(ChessBoard::BLACK, false);
+}
+
+// Caller holds the mutex
+SyzygyTable* SyzygyTablebase::getTable(const ChessBoard& board, bool dtz, bool& black_stronger) {
+  std::string white_code = material_code(board, ChessBoard::WHITE);
+  std::string black_code = material_code(board, ChessBoard::BLACK);
+  const char* extension = dtz ? ".rtbz" : ".rtbw";
+
+  for (const std::string& code : {white_code, black_code}) {
+    std::string name = code + extension;
+    auto it = tables.find(name);
+    if (it == tables.end()) {
+      auto file = files.find(name);
+      if (file == files.end()) continue;
+      it = tables.emplace(name, std::make_unique<SyzygyTable>(code, file->second, dtz)).first;
+    }
+
+    SyzygyTable* table = it->second.get();
+    if (!table->ready && !table->failed && table->map()) {
+      std::cout << "[SYZY] Mapped " << name << std::endl;
+    }
+    if (table->failed) return nullptr;
+    black_stronger = code != white_code;
+    return table;
+  }
+  return nullptr;
+}
+
+int SyzygyTablebase::probeTable(const ChessBoard& board, bool dtz, int wdl, int& state) {
+  if (__builtin_popcountll(board.get_occupancy(ChessBoard::BOTH)) == 2) return DRAW;  // KvK
+
+  bool black_stronger = false;
+  SyzygyTable* table = getTable(board, dtz, black_stronger);
+  if (!table) return state = PROBE_FAIL, 0;
+  return probe_table(*table, board, black_stronger, wdl, state);
+}
+
+/**
+ * The tables store "don't care" values where the side to move has a winning
+ * capture, and may store a loss where a capture draws, because that
+ * compresses better. So captures (and with check_zeroing pawn moves too, for
+ * DTZ) are searched and the best of them is compared with the stored value.
+ */
+int SyzygyTablebase::search(ChessBoard& board, bool check_zeroing, int& state) {
+  int best = LOSS;
+  int value;
+  int move_count = 0;
+  MoveList moves;
+  board.generate_legal_moves(moves);
+
+  for (Move move : moves) {
+    if (!move.is_capture() && (!check_zeroing || !is_zeroing(board, move))) continue;
+    move_count++;
+
+    board.make_move(move);
+    value = -search(board, false, state);
+    board.unmake_move(move);
+    if (state == PROBE_FAIL) return DRAW;
+
+    if (value > best) {
+      best = value;
+      if (value >= WIN) return state = PROBE_ZEROING, value;
+    }
+  }
+
+  // When every legal move was searched the stored value is not needed, and
+  // may be wrong (en passant rights are not part of the tables)
+  bool no_more_moves = move_count && move_count == moves.size();
+  if (no_more_moves) {
+    value = best;
+  } else {
+    value = probeTable(board, false, DRAW, state);
+    if (state == PROBE_FAIL) return DRAW;
+  }
+
+  if (best >= value) {
+    state = (best > DRAW || no_more_moves) ? PROBE_ZEROING : PROBE_OK;
+    return best;
+  }
+  state = PROBE_OK;
+  return value;
+}
+
+int SyzygyTablebase::wdlScore(ChessBoard& board, int& state) {
+  state = PROBE_OK;
+  return search(board, false, state);
+}
+
+int SyzygyTablebase::dtzScore(ChessBoard& board, int& state) {
+  state = PROBE_OK;
+  int wdl = search(board, true, state);
+  if (state == PROBE_FAIL || wdl == DRAW) return 0;
+  if (state == PROBE_ZEROING) return dtz_before_zeroing(wdl);
+
+  int dtz = probeTable(board, true, wdl, state);
+  if (state == PROBE_FAIL) return 0;
+  if (state != PROBE_CHANGE_STM) {
+    return (dtz + 100 * (wdl == BLESSED_LOSS || wdl == CURSED_WIN)) * sign_of(wdl);
+  }
+
+  // The table holds the other side to move: take the best DTZ one ply ahead
+  int min_dtz = 0xFFFF;
+  MoveList moves;
+  board.generate_legal_moves(moves);
+  for (Move move : moves) {
+    bool zeroing = is_zeroing(board, move);
+    board.make_move(move);
+
+    // For zeroing moves the DTZ before the move, with the sign of the result
+    dtz = zeroing ? -dtz_before_zeroing(search(board, false, state)) : -dtzScore(board, state);
+    if (dtz == 1 && is_mate(board)) min_dtz = 1;
+    if (!zeroing) dtz += sign_of(dtz);
+    if (dtz < min_dtz && sign_of(dtz) == sign_of(wdl)) min_dtz = dtz;
+
+    board.unmake_move(move);
+    if (state == PROBE_FAIL) return 0;
+  }
+  return min_dtz == 0xFFFF ? -1 : min_dtz;
+}
+
+bool SyzygyTablebase::probeWdl(const ChessBoard& position, int& wdl) {
+  if (!covers(position)) return false;
+  std::lock_guard<std::mutex> lock(mutex);
+  ChessBoard board = position;
+  int state;
+  wdl = wdlScore(board, state);
+  return state != PROBE_FAIL;
+}
+
+bool SyzygyTablebase::probeDtz(const ChessBoard& position, int& dtz) {
+  if (!covers(position)) return false;
+  std::lock_guard<std::mutex> lock(mutex);
+  ChessBoard board = position;
+  int state;
+  dtz = dtzScore(board, state);
+  return state != PROBE_FAIL;
+}
+
+bool SyzygyTablebase::probeRoot(const ChessBoard& position, Move& move) {
+  if (!covers(position)) return false;
+  std::lock_guard<std::mutex> lock(mutex);
+  ChessBoard board = position;
+  MoveList moves;
+  board.generate_legal_moves(moves);
+  if (moves.empty()) return false;
+
+  // Rank by result under the 50-move rule first, then by DTZ: the quickest
+  // progress when winning, the slowest when losing
+  int clock = board.get_halfmove_clock();
+  Move best_move;
+  int best_rank = 0;
+  int best_dtz = 0;
+  for (Move candidate : moves) {
+    int state = PROBE_OK;
+    bool zeroing = is_zeroing(board, candidate);
+    board.make_move(candidate);
+
+    int dtz;
+    if (zeroing) {
+      dtz = dtz_before_zeroing(-wdlScore(board, state));
+    } else {
+      dtz = -dtzScore(board, state);
+      dtz += sign_of(dtz);
+    }
+    if (dtz == 2 && is_mate(board)) dtz = 1;
+
+    board.unmake_move(candidate);
+    if (state == PROBE_FAIL) return false;
+
+    int rank = dtz > 0 ? (dtz + clock <= 100 ? 2 : 1) : dtz < 0 ? (clock - dtz <= 100 ? -2 : -1) : 0;
+    if (best_move.is_null() || rank > best_rank || (rank == best_rank && -dtz > -best_dtz)) {
+      best_move = candidate;
+      best_rank = rank;
+      best_dtz = dtz;
+    }
+  }
+
+  char uci[6];
+  best_move.to_uci(uci);
+  std::cout << "[SYZY] " << uci << " dtz " << best_dtz << std::endl;
+  move = best_move;
+  return true;
+}
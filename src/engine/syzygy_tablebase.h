@@ -0,0 +1,70 @@
+#ifndef SYZYGY_TABLEBASE_H
+#define SYZYGY_TABLEBASE_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "bitboard.h"
+
+struct SyzygyTable;
+
+/**
+ * Syzygy endgame tablebase prober (WDL .rtbw and DTZ .rtbz files).
+ *
+ * init() only lists the tablebase directories. A table file is opened and
+ * memory-mapped the first time a position with its material is probed, so
+ * startup stays cheap and only the pages actually read become resident.
+ * Positions with castling rights are never in the tables.
+ */
+class SyzygyTablebase {
+public:
+    static constexpr int MAX_PIECES = 7;
+
+    // Win/draw/loss from the side to move, cursed and blessed are 50-move rule draws
+    enum WdlScore { LOSS = -2, BLESSED_LOSS = -1, DRAW = 0, CURSED_WIN = 1, WIN = 2 };
+
+    SyzygyTablebase();
+    ~SyzygyTablebase();
+
+    SyzygyTablebase(const SyzygyTablebase&) = delete;
+    SyzygyTablebase& operator=(const SyzygyTablebase&) = delete;
+
+    /**
+     * Register the tables found in one or more directories
+     * @param paths: directories separated by ':', a leading "~/" is expanded to $HOME
+     * @return true when at least one table file was found
+     */
+    bool init(const std::string& paths);
+    int getMaxPieces() const { return max_pieces; }
+
+    // @return false when the position is not covered by the available tables
+    bool probeWdl(const ChessBoard& board, int& wdl);
+
+    // Distance to zeroing (capture or pawn move) in plies, signed like the WDL score
+    bool probeDtz(const ChessBoard& board, int& dtz);
+
+    /**
+     * Pick the best move of the position: the quickest win under the 50-move
+     * rule, a draw, or the longest resistance when lost
+     * @param move: receives the best move
+     * @return false when any move leads out of the available tables
+     */
+    bool probeRoot(const ChessBoard& board, Move& move);
+
+private:
+    std::unordered_map<std::string, std::string> files;  // "KRvK.rtbw" -> full path
+    std::unordered_map<std::string, std::unique_ptr<SyzygyTable>> tables;  // created on first probe
+    int max_pieces = 0;
+    std::mutex mutex;
+
+    bool covers(const ChessBoard& board) const;
+    SyzygyTable* getTable(const ChessBoard& board, bool dtz, bool& black_stronger);
+    int probeTable(const ChessBoard& board, bool dtz, int wdl, int& state);
+    int search(ChessBoard& board, bool check_zeroing, int& state);
+    int wdlScore(ChessBoard& board, int& state);
+    int dtzScore(ChessBoard& board, int& state);
+};
+
+#endif // SYZYGY_TABLEBASE_H
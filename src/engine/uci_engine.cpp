@@ -1,7 +1,10 @@
 #include "uci_engine.h"
-#include <sstream>
+#include <charconv>
+#include <cstdlib>
 #include <cstring>
 #include <cerrno>
+#include <poll.h>
+#include <sys/syscall.h>
 
 bool UCIEngine::startEngine(bool debug, const std::string& enginePath) {
   this->debug = debug;
@@ -43,14 +46,28 @@ bool UCIEngine::startEngine(bool debug, const std::string& enginePath) {
     // Set non-blocking reads on stdout
     fcntl(engine_stdout[0], F_SETFL, O_NONBLOCK);
 
-    // Start observer thread
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd == -1 || wake_fd == -1) {
+      std::cerr << "[GNUC] Failed to create epoll/eventfd: " << strerror(errno) << std::endl;
+      return false;
+    }
+#ifdef SYS_pidfd_open
+    // Without a pidfd the engine exit is still seen as EOF on its stdout
+    exit_fd = syscall(SYS_pidfd_open, engine_pid, 0);
+#endif
+    for (int fd : {engine_stdout[0], wake_fd, exit_fd}) {
+      if (fd == -1) continue;
+      epoll_event event = {};
+      event.events = EPOLLIN;
+      event.data.fd = fd;
+      epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    // Start the reactor thread, it also runs the async command queue
     is_running = true;
     observer_thread = std::make_unique<std::thread>(&UCIEngine::observerLoop, this);
 
-    // Start command processor thread
-    command_thread_running = true;
-    command_thread = std::make_unique<std::thread>(&UCIEngine::commandProcessorLoop, this);
-
     std::cout << "[GNUC] Engine started with PID: " << engine_pid << std::endl;
     return true;
   }
@@ -59,67 +76,254 @@ bool UCIEngine::startEngine(bool debug, const std::string& enginePath) {
 bool UCIEngine::sendCommand(const std::string& command, bool silent) {
   if (engine_stdin[1] == -1) return false;
 
+  if (command.compare(0, 3, "go ") == 0) go_count++;
   std::string full_command = command + "\n";
   int wbytes = write(engine_stdin[1], full_command.c_str(), full_command.length());
-  fsync(engine_stdin[1]);
 
   if (!silent) std::cout << "[GNUC] Sent: " << command << " (w:" << wbytes << ")" << std::endl;
   return true;
 }
 
-void UCIEngine::sendMoveAsync(const std::string& move, MoveCallback callback) {
+void UCIEngine::sendMoveAsync(Move move, MoveCallback callback) {
     std::lock_guard<std::mutex> lock(queue_mutex);
-    
-    // Build the position command
-    std::string moves = "";
-    if (move.size() > 4) {
-        moves = "position fen " + move;
-    } else {
-        moves_history = moves_history + " " + move;
-        moves = "position startpos moves" + moves_history;
+    moves_history.push_back(move);
+    trackMove(move);
+
+    if (ponder_state == PONDERING && move == ponder_move) {
+        // The engine has been searching this very position on the user's time
+        if (debug) std::cout << "[GNUC] Ponder hit" << std::endl;
+        ponder_hit_callback = bestMoveCallback(callback);
+        ponder_state = PONDER_HIT;
+        wake();
+        return;
+    }
+    stopPondering();
+    searchAsync(positionCommand(), callback);
+}
+
+void UCIEngine::sendPositionAsync(const std::string& fen, MoveCallback callback) {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    stopPondering();
+    position_valid = position.set_fen(fen);
+    searchAsync("position fen " + fen, callback);
+}
+
+// Caller holds queue_mutex, position is the one to search
+void UCIEngine::searchAsync(const std::string& position_command, MoveCallback callback) {
+    // Known position: answer right away without waking the engine
+    uint64_t key = position.get_hash();
+    bool cacheable = cache && position_valid;
+    std::string cached;
+    if (cacheable && cache->lookup(key, difficult, move_time, cached)) {
+        Move move = position.find_uci_move(cached);
+        if (!move.is_null()) {
+            if (debug) std::cout << "[GNUC] Cached bestmove: " << cached << std::endl;
+            if (callback) callback(move);
+            return;
+        }
     }
   
-    sendCommand(moves, !debug);
+    // Queued behind a ponder search that is being stopped, if any
+    command_queue.push({position_command, nullptr, "", 0});
+    command_queue.push({"go depth " + std::to_string(difficult), bestMoveCallback(callback),
+                        "bestmove", move_time * 1000});
     
-    // Queue search command with callback
-    command_queue.push({"go depth " + std::to_string(difficult), 
-                       [this, callback](const std::string& response) {
-                          if (callback) callback(response);
-                       }, 
-                       "bestmove", move_time * 1000});
-    
-    queue_cv.notify_one();
+    wake();
 }
 
-void UCIEngine::commandProcessorLoop() {
-  while (command_thread_running) {
-    AsyncCommand cmd;
-    std::unique_lock<std::mutex> lock(queue_mutex);
-    queue_cv.wait(lock, [this] { return !command_queue.empty() || !command_thread_running; });
+// Caller holds queue_mutex. The bestmove line is parsed on the position searched
+// now, the answer is cached and its ponder move remembered
+UCIEngine::ResponseCallback UCIEngine::bestMoveCallback(MoveCallback callback) {
+    uint64_t key = position.get_hash();
+    bool cacheable = cache && position_valid;
+    return [this, callback, cacheable, key, searched = position, depth = difficult,
+            time = move_time](const std::string& response) {
+        std::string best = extractMove(response);
+        Move move = searched.find_uci_move(best);
+        // Runs on the reactor thread, stop_sent and search_info still describe
+        // this search. A stopped one (early stop, deadline) is only cached for
+        // the depth of its last info line
+        int reached = stop_sent ? std::min(search_info.depth, depth) : depth;
+        if (cacheable && !move.is_null() && reached > 0) cache->store(key, reached, time, best);
+        expectPonder(searched, move, response);
+        if (callback) callback(move);
+    };
+}
 
-    if (!command_thread_running) break;
+// Remember the reply the engine expects to its move, "bestmove e2e4 ponder e7e5"
+void UCIEngine::expectPonder(const ChessBoard& searched, Move best, const std::string& response) {
+    Move reply;
+    size_t pos = response.find(" ponder ");
+    if (ponder_enabled && !best.is_null() && pos != std::string::npos) {
+        size_t start = pos + 8;
+        size_t end = response.find_first_of(" \t", start);
+        ChessBoard after = searched;
+        after.make_move(best);
+        reply = after.find_uci_move(response.substr(start, end == std::string::npos ? std::string::npos : end - start));
+    }
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    ponder_best = best;
+    ponder_move = reply;
+}
 
-    cmd = command_queue.front();
-    command_queue.pop();
+// Caller holds queue_mutex, the engine move was just added to the history
+void UCIEngine::startPondering() {
+    if (debug) {
+        char uci[6];
+        ponder_move.to_uci(uci);
+        std::cout << "[GNUC] Pondering on " << uci << std::endl;
+    }
+
+    command_queue.push({positionCommand(ponder_move), nullptr, "", 0, true});
+    command_queue.push({"go ponder depth " + std::to_string(difficult), nullptr,
+                        "bestmove", move_time * 1000, true});
+    ponder_state = PONDERING;
+    wake();
+}
 
-    // Send the command
-    sendCommand(cmd.command, !debug);
+// Caller holds queue_mutex. The user played something else: a running ponder
+// search is stopped and its bestmove dropped, a queued one never gets sent
+void UCIEngine::stopPondering() {
+    if (ponder_state == PONDER_IDLE) return;
+    ponder_state = PONDER_IDLE;
+    ponder_hit_callback = nullptr;
 
-    if (!cmd.expected_response.empty()) {
-      if (waitForResponse(cmd.expected_response, cmd.timeout_ms)) {
-        if (cmd.callback) cmd.callback(extractMove(getLastCommand()));
-      } else {
-        if(debug) std::cerr << "[GNUC] Async force stop:" << std::endl;
+    if (command_in_flight && current_command.ponder) {
+        if (debug) std::cout << "[GNUC] Ponder miss" << std::endl;
         sendCommand("stop", !debug);
-        if (waitForResponse(cmd.expected_response, 1000)) {
-          std::string response = extractMove(getLastCommand());
-          if(debug) std::cout << "[GNUC] Async response: " << response << std::endl;
-          if (cmd.callback) cmd.callback(response);
+        return;
+    }
+    std::queue<AsyncCommand> kept;
+    for (; !command_queue.empty(); command_queue.pop()) {
+        if (!command_queue.front().ponder) kept.push(std::move(command_queue.front()));
+    }
+    command_queue.swap(kept);
+}
+
+void UCIEngine::setPonder(bool enabled) {
+    ponder_enabled = enabled;
+    sendCommand(std::string("setoption name Ponder value ") + (enabled ? "true" : "false"), !debug);
+}
+
+// Shortest "position" command for the game so far, built in a buffer reused
+// across turns: the whole move list early on, later the FEN after the last
+// capture or pawn move plus the moves since. Earlier positions can not repeat,
+// so the engine still sees everything it needs for repetitions and the 50-move rule.
+// A non-null extra move is appended after the game moves (the ponder move).
+const std::string& UCIEngine::positionCommand(Move extra) {
+    size_t first = 0;
+    if (position_valid && !anchor_fen.empty() && anchor_fen.size() < anchor_ply * 5) {
+        position_text.assign("position fen ").append(anchor_fen);
+        first = anchor_ply;
+    } else {
+        position_text.assign("position startpos");
+    }
+
+    if (first < moves_history.size() || !extra.is_null()) {
+        position_text += " moves";
+        char uci[6];
+        for (size_t i = first; i < moves_history.size(); i++) {
+            position_text += ' ';
+            position_text.append(uci, moves_history[i].to_uci(uci));
+        }
+        if (!extra.is_null()) {
+            position_text += ' ';
+            position_text.append(uci, extra.to_uci(uci));
         }
-      }
-      commands.clear();
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return position_text;
+}
+
+// Reactor thread: send the next queued command once the previous one is answered
+void UCIEngine::startNextCommand() {
+  std::lock_guard<std::mutex> lock(queue_mutex);
+  while (!command_in_flight && !command_queue.empty()) {
+    current_command = std::move(command_queue.front());
+    command_queue.pop();
+
+    sendCommand(current_command.command, !debug);
+
+    if (!current_command.expected_response.empty()) {
+      command_in_flight = true;
+      stop_sent = false;
+      search_info = SearchInfo();
+      stable_depth = stable_count = 0;
+      command_deadline = std::chrono::steady_clock::now() +
+                         std::chrono::milliseconds(current_command.timeout_ms);
+    }
+  }
+
+  // Ponder hit: the running ponder search becomes the answer to the user move
+  if (ponder_state == PONDER_HIT && command_in_flight && current_command.ponder) {
+    sendCommand("ponderhit", !debug);
+    current_command.callback = std::move(ponder_hit_callback);
+    ponder_hit_callback = nullptr;
+    current_command.ponder = false;
+    command_deadline = std::chrono::steady_clock::now() +
+                       std::chrono::milliseconds(current_command.timeout_ms);
+    ponder_state = PONDER_IDLE;
+  }
+}
+
+void UCIEngine::completeCommand(const std::string& response) {
+  ResponseCallback callback;
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    command_in_flight = false;
+    callback = std::move(current_command.callback);
+    if (current_command.ponder) {
+      // A ponder search that finished on its own before its ponderhit went out
+      // searched the position the user reached, its move answers the user.
+      // Stopped or not hit yet, the move is stale
+      if (ponder_state == PONDER_HIT) callback = std::move(ponder_hit_callback);
+      ponder_hit_callback = nullptr;
+      ponder_state = PONDER_IDLE;
+    }
+  }
+  if (debug && stop_sent) std::cout << "[GNUC] Async response: " << response << std::endl;
+  if (callback) callback(response);
+  clearCommands();
+}
+
+// Deadline passed: ask the engine to stop, then give up one second later
+void UCIEngine::expireCommand() {
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    if (!command_in_flight || current_command.ponder ||
+        std::chrono::steady_clock::now() < command_deadline) return;
+    if (!stop_sent) {
+      if (debug) std::cerr << "[GNUC] Async force stop:" << std::endl;
+      sendCommand("stop", !debug);
+      stop_sent = true;
+      command_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(1000);
+      return;
+    }
+    std::cerr << "[GNUC] No bestmove after stop, search dropped" << std::endl;
+    command_in_flight = false;
+    timed_out = true;
+  }
+  clearCommands();
+  notifyError("Search got no bestmove");
+}
+
+// Heartbeat: only a "readyok" sent after this "isready" counts
+bool UCIEngine::isResponsive(int timeout_ms) {
+  std::unique_lock<std::mutex> lock(response_mutex);
+  uint64_t seen = readyok_count;
+  if (!is_running || !sendCommand("isready", !debug)) return false;
+  return response_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                              [&] { return readyok_count > seen || !is_running; }) && is_running;
+}
+
+bool UCIEngine::isBusy() {
+  std::lock_guard<std::mutex> lock(queue_mutex);
+  return command_in_flight || !command_queue.empty();
+}
+
+void UCIEngine::wake() {
+  uint64_t one = 1;
+  if (wake_fd != -1 && write(wake_fd, &one, sizeof(one)) < 0 && debug) {
+    std::cerr << "[GNUC] Wake failed: " << strerror(errno) << std::endl;
   }
 }
 
@@ -134,9 +338,13 @@ std::string UCIEngine::getLastCommand() {
   return commands.back();
 }
 
-std::string UCIEngine::extractMove(std::string response) { 
-  std::string move = response.substr(9, 4);
-  return move;
+// Move token of "bestmove e7e8q ponder d2d1", promotion suffix included
+std::string UCIEngine::extractMove(const std::string& response) {
+  size_t start = response.find("bestmove ");
+  if (start == std::string::npos) return "";
+  start += 9;
+  size_t end = response.find_first_of(" \t", start);
+  return response.substr(start, end == std::string::npos ? std::string::npos : end - start);
 }
 
 void UCIEngine::clearCommands() {
@@ -144,89 +352,208 @@ void UCIEngine::clearCommands() {
   commands.clear();
 }
 
+// Sleeps in epoll_wait until the engine writes, a command is queued, the
+// engine exits or the in-flight command times out: no polling when idle
 void UCIEngine::observerLoop() {
-  char buffer[4096];
   std::string partial_line;
 
   while (is_running) {
-    fd_set read_fds;
-    FD_ZERO(&read_fds);
-    FD_SET(engine_stdout[0], &read_fds);
-
-    struct timeval timeout;
-    timeout.tv_sec = 0;
-    timeout.tv_usec = 100000; // 100ms
-
-    int result = select(engine_stdout[0] + 1, &read_fds, nullptr, nullptr, &timeout);
-
-    if (result > 0 && FD_ISSET(engine_stdout[0], &read_fds)) {
-      ssize_t bytes_read = read(engine_stdout[0], buffer, sizeof(buffer) - 1);
-
-      if (bytes_read > 0) {
-        buffer[bytes_read] = '\0';
-        processEngineOutput(buffer, partial_line);
-      } else if (bytes_read == 0) {
-        // Engine closed stdout
-        std::cout << "[GNUC] Engine closed output" << std::endl;
-        break;
-      } else {
-        // Read error
-        if (errno != EAGAIN && errno != EWOULDBLOCK) {
-          std::cerr << "[GNUC] Read error: " << strerror(errno) << std::endl;
-          break;
-        }
-      }
+    int timeout_ms = -1;
+    if (command_in_flight && !current_command.ponder) {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          command_deadline - std::chrono::steady_clock::now()).count();
+      timeout_ms = left > 0 ? static_cast<int>(left) + 1 : 0;
+    }
+
+    epoll_event events[3];
+    int ready = epoll_wait(epoll_fd, events, 3, timeout_ms);
+    if (ready < 0) {
+      if (errno == EINTR) continue;
+      std::cerr << "[GNUC] epoll_wait error: " << strerror(errno) << std::endl;
+      break;
     }
 
-    // Check if engine process is still alive
-    if (engine_pid > 0) {
-      int status;
-      if (waitpid(engine_pid, &status, WNOHANG) == engine_pid) {
+    bool closed = false;
+    for (int i = 0; i < ready; i++) {
+      int fd = events[i].data.fd;
+      if (fd == engine_stdout[0]) {
+        if (!readEngineOutput(partial_line)) closed = true;
+      } else if (fd == wake_fd) {
+        uint64_t count;
+        if (read(wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) closed = true;
+      } else if (fd == exit_fd) {
+        // Keep whatever the engine wrote before exiting
+        readEngineOutput(partial_line);
         std::cout << "[GNUC] Engine process terminated" << std::endl;
-        break;
+        closed = true;
       }
     }
-    // Small sleep to prevent CPU spinning
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (closed) break;
+
+    expireCommand();
+    startNextCommand();
   }
 
+  // Left the loop on its own: the engine died or its pipe broke
+  bool lost = is_running;
   is_running = false;
+  response_cv.notify_all();
+  if (lost) notifyError("Engine process terminated");
 }
 
-void UCIEngine::processEngineOutput(const char* data, std::string& partial_line) {
-  std::string output = partial_line + data;
-  partial_line.clear();
+// Drain the non-blocking stdout pipe, false once the engine closed it
+bool UCIEngine::readEngineOutput(std::string& partial_line) {
+  char buffer[4096];
+  while (true) {
+    ssize_t bytes_read = read(engine_stdout[0], buffer, sizeof(buffer));
+    if (bytes_read > 0) {
+      processEngineOutput(buffer, bytes_read, partial_line);
+    } else if (bytes_read == 0) {
+      std::cout << "[GNUC] Engine closed output" << std::endl;
+      return false;
+    } else if (errno == EINTR) {
+      continue;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return true;
+    } else {
+      std::cerr << "[GNUC] Read error: " << strerror(errno) << std::endl;
+      return false;
+    }
+  }
+}
 
-  std::vector<std::string> lines;
-  size_t start = 0;
-  size_t end = output.find('\n');
+// Lines are views into the read buffer, only a line split across reads is copied
+void UCIEngine::processEngineOutput(const char* data, size_t length, std::string& partial_line) {
+  const char* end = data + length;
+  while (data < end) {
+    const char* newline = static_cast<const char*>(memchr(data, '\n', end - data));
+    if (!newline) {
+      partial_line.append(data, end - data);
+      return;
+    }
 
-  while (end != std::string::npos) {
-    std::string line = output.substr(start, end - start);
-    // Remove carriage return if present
-    if (!line.empty() && line.back() == '\r') {
-      line.pop_back();
+    std::string_view line(data, newline - data);
+    if (!partial_line.empty()) {
+      partial_line.append(line.data(), line.size());
+      line = partial_line;
     }
-    lines.push_back(line);
-    start = end + 1;
-    end = output.find('\n', start);
+    // Remove carriage return if present
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+    processLine(line);
+    partial_line.clear();
+    data = newline + 1;
   }
+}
 
-  // Save incomplete line for next read
-  if (start < output.length()) {
-    partial_line = output.substr(start);
+void UCIEngine::processLine(std::string_view line) {
+  if (line.compare(0, 5, "info ") == 0) {
+    parseInfo(line);
+  } else if (isCommandResponse(line)) {
+    std::string response(line);
+    storeCommandResponse(response);
+    if (command_in_flight && response.find(current_command.expected_response) != std::string::npos) {
+      completeCommand(response);
+    }
   }
+  if (debug) std::cout << "[GNUC] " << line << std::endl;
+}
 
-  // Process complete lines
-  for (const auto& line : lines) {
-    if (isCommandResponse(line)) {
-      storeCommandResponse(line);
+// "info depth 12 seldepth 18 multipv 1 score cp 23 nodes 81234 nps 950000 time 85 pv e2e4 e7e5"
+void UCIEngine::parseInfo(std::string_view line) {
+  size_t pos = 5;
+  auto next = [&]() {
+    while (pos < line.size() && line[pos] == ' ') pos++;
+    size_t start = pos;
+    while (pos < line.size() && line[pos] != ' ') pos++;
+    return line.substr(start, pos - start);
+  };
+  auto number = [&](auto& value) {
+    std::string_view token = next();
+    std::from_chars(token.data(), token.data() + token.size(), value);
+  };
+
+  // Fields missing from the line keep their value from earlier lines
+  SearchInfo info = search_info;
+  info.multipv = 1;
+  bool has_score = false;
+  for (std::string_view key = next(); !key.empty(); key = next()) {
+    if (key == "depth") number(info.depth);
+    else if (key == "seldepth") number(info.seldepth);
+    else if (key == "multipv") number(info.multipv);
+    else if (key == "nodes") number(info.nodes);
+    else if (key == "nps") number(info.nps);
+    else if (key == "time") number(info.time_ms);
+    else if (key == "score") {
+      info.mate = next() == "mate";
+      number(info.score);
+      has_score = true;
+    } else if (key == "pv") {
+      // Always the last field, the moves run to the end of the line
+      info.pv_length = 0;
+      for (std::string_view move = next(); !move.empty(); move = next()) {
+        if (info.pv_length == SearchInfo::MAX_PV || move.size() >= sizeof(info.pv[0])) continue;
+        memcpy(info.pv[info.pv_length], move.data(), move.size());
+        info.pv[info.pv_length][move.size()] = '\0';
+        info.pv_length++;
+      }
+    } else if (key == "string") {
+      return;  // free text
     }
-    if (debug) std::cout << "[GNUC] " << line << std::endl;
+    // currmove, hashfull, tbhits, bounds... are skipped token by token
+  }
+
+  // Secondary lines of a multi-PV search do not describe the best move
+  if (info.multipv != 1) return;
+
+  search_info = info;
+  publishSearchInfo();
+  if (!has_score) return;
+
+  {
+    std::lock_guard<std::mutex> lock(response_mutex);
+    last_score = (info.mate ? "mate " : "cp ") + std::to_string(info.score);
+  }
+  checkEarlyStop();
+}
+
+void UCIEngine::publishSearchInfo() {
+  info_slots[info_back] = search_info;
+  info_back = info_middle.exchange(info_back | INFO_FRESH, std::memory_order_acq_rel) & 3;
+}
+
+bool UCIEngine::getSearchInfo(SearchInfo& info) {
+  bool fresh = info_middle.load(std::memory_order_relaxed) & INFO_FRESH;
+  if (fresh) info_front = info_middle.exchange(info_front, std::memory_order_acq_rel) & 3;
+  info = info_slots[info_front];
+  return fresh;
+}
+
+// Another iteration that kept the score rarely changes the move, so after
+// EARLY_STOP_DEPTHS of them the engine is asked for its move right away
+void UCIEngine::checkEarlyStop() {
+  const SearchInfo& info = search_info;
+  if (info.depth > stable_depth) {
+    int margin = info.mate ? 0 : EARLY_STOP_MARGIN_CP;
+    bool steady = stable_depth > 0 && info.mate == stable_mate &&
+                  std::abs(info.score - stable_score) <= margin;
+    stable_count = steady ? stable_count + 1 : 0;
+    stable_depth = info.depth;
+  }
+  stable_score = info.score;
+  stable_mate = info.mate;
+
+  std::lock_guard<std::mutex> lock(queue_mutex);
+  if (command_in_flight && !current_command.ponder && !stop_sent &&
+      info.depth >= EARLY_STOP_MIN_DEPTH && stable_count >= EARLY_STOP_DEPTHS) {
+    if (debug) std::cout << "[GNUC] Score stable at depth " << info.depth << ", early stop" << std::endl;
+    sendCommand("stop", !debug);
+    stop_sent = true;
+    command_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(1000);
   }
 }
 
-bool UCIEngine::isCommandResponse(const std::string& response) {
+bool UCIEngine::isCommandResponse(std::string_view response) {
   // Define what constitutes an "important" response
   return (response.find("bestmove") != std::string::npos ||
       response.find("uciok") != std::string::npos ||
@@ -239,16 +566,27 @@ bool UCIEngine::isCommandResponse(const std::string& response) {
 }
 
 void UCIEngine::storeCommandResponse(const std::string& response) {
-  std::lock_guard<std::mutex> lock(response_mutex);
-  commands.push_back(response);
-  
-  // Keep only last MAX_RESPONSES
-  if (commands.size() > MAX_RESPONSES) {
-    commands.erase(commands.begin());
+  {
+    std::lock_guard<std::mutex> lock(response_mutex);
+    commands.push_back(response);
+    if (response.find("readyok") != std::string::npos) readyok_count++;
+    if (response.find("bestmove") != std::string::npos) {
+      // The info lines seen since the previous bestmove belong to this search
+      bestmove_count++;
+      last_bestmove = response;
+      bestmove_score = std::move(last_score);
+      last_score.clear();
+    }
+
+    // Keep only last MAX_RESPONSES
+    if (commands.size() > MAX_RESPONSES) {
+      commands.erase(commands.begin());
+    }
   }
+  response_cv.notify_all();
 }
 
-void UCIEngine::notifyMove(const std::string& move) {
+void UCIEngine::notifyMove(Move move) {
     if (move_callback) {
         move_callback(move);
     }
@@ -269,28 +607,20 @@ void UCIEngine::setErrorCallback(ErrorCallback callback) {
 }
 
 void UCIEngine::shutdown() {
+  if (cache) cache->save();
   is_running = false;
-  command_thread_running = false;
-  
-  // Notify command processor to wake up and exit
-  {
-    std::lock_guard<std::mutex> lock(queue_mutex);
-    queue_cv.notify_one();
-  }
+
+  // Wake the reactor so it sees is_running and exits
+  wake();
 
   if (observer_thread && observer_thread->joinable()) {
     observer_thread->join();
   }
-
-  if (command_thread && command_thread->joinable()) {
-    command_thread->join();
-  }
+  command_in_flight = false;
 
   // Close pipes
   if (engine_stdin[1] != -1) {
     sendCommand("quit");
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
     close(engine_stdin[1]);
     engine_stdin[1] = -1;
   }
@@ -300,15 +630,31 @@ void UCIEngine::shutdown() {
     engine_stdout[0] = -1;
   }
 
-  // Kill engine if still running
+  // Kill engine if it does not quit on its own
   if (engine_pid > 0) {
-    kill(engine_pid, SIGTERM);
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
-    kill(engine_pid, SIGKILL);
+    if (!waitForExit(100)) {
+      kill(engine_pid, SIGTERM);
+      if (!waitForExit(50)) kill(engine_pid, SIGKILL);
+    }
 
     waitpid(engine_pid, nullptr, 0);
     engine_pid = -1;
   }
+
+  for (int* fd : {&exit_fd, &wake_fd, &epoll_fd}) {
+    if (*fd != -1) close(*fd);
+    *fd = -1;
+  }
+}
+
+// With a pidfd return as soon as the engine exits, otherwise just wait
+bool UCIEngine::waitForExit(int timeout_ms) {
+  if (exit_fd != -1) {
+    struct pollfd exited = {exit_fd, POLLIN, 0};
+    return poll(&exited, 1, timeout_ms) > 0;
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+  return false;
 }
 
 void UCIEngine::setDifficult(int difficult) {
@@ -321,35 +667,63 @@ void UCIEngine::setMoveTime(uint32_t move_time) {
 
 // Helper method to wait for specific response
 bool UCIEngine::waitForResponse(const std::string& target, int timeout_ms) {
-  auto start = std::chrono::steady_clock::now();
-
-  while (std::chrono::steady_clock::now() - start < 
-      std::chrono::milliseconds(timeout_ms)) {
-
-    auto responses = getCommands();
-    for (const auto& response : responses) {
-      if (response.find(target) != std::string::npos) {
-        if (debug) std::cout << "[GNUC] waitForResponse found: " << target << std::endl;
-        return true;
-      }
-    }
+  auto found = [&] {
+    return std::any_of(commands.begin(), commands.end(), [&](const std::string& response) {
+      return response.find(target) != std::string::npos;
+    });
+  };
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-  }
+  // Woken by storeCommandResponse, or by the reactor when the engine goes away
+  std::unique_lock<std::mutex> lock(response_mutex);
+  response_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                       [&] { return found() || !is_running; });
+  if (!found()) return false;
 
-  return false;
+  if (debug) std::cout << "[GNUC] waitForResponse found: " << target << std::endl;
+  return true;
 }
 
-std::string UCIEngine::getMovesHistory() { 
-  return moves_history; 
+void UCIEngine::addMoveToHistory(Move move) {
+  std::lock_guard<std::mutex> lock(queue_mutex);
+  stopPondering();
+  moves_history.push_back(move);
+  trackMove(move);
+
+  // Our own move went in: think on the reply the engine expects
+  bool expected = !ponder_best.is_null() && move == ponder_best && !ponder_move.is_null();
+  ponder_best = Move();
+  if (expected && position_valid) startPondering();
 }
 
-void UCIEngine::addMoveToHistory(const std::string& move) {
-  moves_history = moves_history + " " + move;
+// Follow the game on the local board so cache lookups use the right position
+void UCIEngine::trackMove(Move move) {
+  if (!position_valid) return;
+  MoveList legal;
+  position.generate_legal_moves(legal);
+  if (std::find(legal.begin(), legal.end(), move) == legal.end()) {
+    position_valid = false;
+    return;
+  }
+  position.make_move(move);
+
+  // Nothing before a capture or pawn move matters to the engine any more
+  if (position.get_halfmove_clock() == 0) {
+    char fen[ChessBoard::FEN_BUFFER_SIZE];
+    position.get_fen(fen, sizeof(fen));
+    anchor_fen = fen;
+    anchor_ply = moves_history.size();
+  }
 }
 
 void UCIEngine::newGame() {
+  std::lock_guard<std::mutex> lock(queue_mutex);
+  stopPondering();
+  ponder_best = Move();
   moves_history.clear();
+  anchor_fen.clear();
+  anchor_ply = 0;
+  position.set_initial_position();
+  position_valid = true;
   sendCommand("ucinewgame");
 }
 
@@ -378,23 +752,43 @@ void UCIEngine::searchWithDepthAndTimeout(int depth, int max_time_ms) {
     timeout_thread.join();
 }
 
-std::string UCIEngine::sendMove(const std::string& move) {
-  std::string moves = "";
-  if (move.size() > 4) {
-    moves = "position fen " + move;
-  }else{
-    moves_history = moves_history + " " + move;
-    moves = "position startpos moves" + moves_history;
+bool UCIEngine::analyzeFen(const std::string& fen, std::string& best_move, std::string& score) {
+  if (!is_running) return false;
+  if (!sendCommand("position fen " + fen, !debug)) return false;
+  sendCommand("go depth " + std::to_string(difficult), !debug);
+
+  // Only the bestmove answering this "go" counts, one still owed to an
+  // earlier search that never answered in time arrives first
+  uint64_t search = go_count;
+  auto answered = [&](int timeout_ms) {
+    std::unique_lock<std::mutex> lock(response_mutex);
+    return response_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                                [&] { return bestmove_count >= search || !is_running; }) &&
+           bestmove_count >= search;
+  };
+  if (!answered(move_time * 1000)) {
+    sendCommand("stop", !debug);
+    if (!answered(1000)) return false;
   }
-  sendCommand(moves, !debug);
+
+  std::lock_guard<std::mutex> lock(response_mutex);
+  best_move = extractMove(last_bestmove);
+  score = bestmove_score;
+  return true;
+}
+
+Move UCIEngine::sendMove(Move move) {
+  moves_history.push_back(move);
+  trackMove(move);
+  sendCommand(positionCommand(), !debug);
   // sendCommand("go movetime 3000", debug);
   searchWithDepthAndTimeout(difficult, move_time * 1000);
   // Wait for bestmove asynchronously
   if (waitForResponse("bestmove", move_time * 1000 * 10)) {
-    return extractMove(getLastCommand());
+    return position.find_uci_move(extractMove(getLastCommand()));
   }
   else
-    return "";
+    return Move();
 }
 
 
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <mutex>
 #include <atomic>
@@ -11,18 +12,39 @@
 #include <functional>
 #include <queue>
 #include <condition_variable>
+#include <chrono>
 #include <fcntl.h>
 #include <unistd.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/wait.h>
 #include <algorithm>
 #include <signal.h>
 
+#include "bitboard.h"
+#include "engine_cache.h"
+
+// Progress of the running search from its "info" lines, score from the side to move
+struct SearchInfo {
+    static constexpr int MAX_PV = 8;
+
+    int depth = 0;
+    int seldepth = 0;
+    int multipv = 1;
+    bool mate = false;  // score counts moves to mate instead of centipawns
+    int score = 0;
+    uint64_t nodes = 0;
+    uint64_t nps = 0;
+    uint32_t time_ms = 0;
+    int pv_length = 0;
+    char pv[MAX_PV][6] = {};  // UCI text, first moves of the principal variation
+};
+
 class UCIEngine {
 public:
     // Callback types
     using ResponseCallback = std::function<void(const std::string& response)>;
-    using MoveCallback = std::function<void(const std::string& move)>;
+    using MoveCallback = std::function<void(Move move)>;  // null move when the engine has none
     using ErrorCallback = std::function<void(const std::string& error)>;
 
 private:
@@ -30,40 +52,96 @@ private:
     int engine_stdin[2];  // [0] read, [1] write
     int engine_stdout[2]; // [0] read, [1] write
     pid_t engine_pid;
+
+    // Reactor: one epoll set watching engine stdout, wake_fd (eventfd, queued
+    // commands and shutdown) and exit_fd (pidfd, -1 on kernels without it)
+    int epoll_fd = -1;
+    int wake_fd = -1;
+    int exit_fd = -1;
     
     // Thread control
     std::atomic<bool> is_running;
     std::unique_ptr<std::thread> observer_thread;
     
-    // Response storage
+    // Response storage, waiters sleep on response_cv until a line matches
     std::vector<std::string> commands;
     std::mutex response_mutex;
-    std::string moves_history = "";
+    std::condition_variable response_cv;
+    uint64_t readyok_count = 0;  // heartbeat answers, guarded by response_mutex
+    std::vector<Move> moves_history;  // UCI text is only built for the position command
+    std::string anchor_fen;  // position after the last capture or pawn move
+    size_t anchor_ply = 0;   // moves_history index it was reached at
+    std::string position_text;  // last position command, its capacity is reused
+    std::string last_score;  // "cp 23" or "mate 3" from the latest info line of the running search
+    // Every "go" gets exactly one bestmove, in order: the n-th bestmove answers
+    // the n-th "go". Counted across all searches so a blocking one can skip
+    // answers owed to earlier ones
+    std::atomic<uint64_t> go_count{0};
+    uint64_t bestmove_count = 0;  // guarded by response_mutex, like the two below
+    std::string last_bestmove;
+    std::string bestmove_score;  // last_score of the search that last_bestmove answered
     static const size_t MAX_RESPONSES = 50;
+
+    // Search info handoff without locks: the reactor fills a back slot and
+    // swaps it with the middle one, a single reader swaps its front slot out
+    static constexpr uint8_t INFO_FRESH = 4;
+    SearchInfo search_info;  // accumulated from the info lines of the current search
+    SearchInfo info_slots[3];
+    std::atomic<uint8_t> info_middle{1};
+    uint8_t info_back = 0;   // reactor thread only
+    uint8_t info_front = 2;  // reader only
+
+    // Stop the search once the score held for a few iterations instead of waiting out move_time
+    static const int EARLY_STOP_MIN_DEPTH = 6;
+    static const int EARLY_STOP_DEPTHS = 3;
+    static const int EARLY_STOP_MARGIN_CP = 15;
+    int stable_depth = 0;
+    int stable_count = 0;
+    int stable_score = 0;
+    bool stable_mate = false;
     bool debug;
     int difficult = 1;
     uint16_t move_time = 2;
 
+    // Answer cache, keyed by the position the engine is asked about
+    ChessBoard position;
+    bool position_valid = true;  // false when a move could not be followed
+    std::shared_ptr<EngineCache> cache;  // none unless set, may be shared by several engines
+
     // Async command queue
     struct AsyncCommand {
         std::string command;
         ResponseCallback callback;
         std::string expected_response;
         int timeout_ms;
+        bool ponder = false;  // runs on the user's time, no deadline
     };
     
     std::queue<AsyncCommand> command_queue;
     std::mutex queue_mutex;
-    std::condition_variable queue_cv;
-    std::unique_ptr<std::thread> command_thread;
-    std::atomic<bool> command_thread_running;
+
+    // Command awaiting its response, changed by the reactor under queue_mutex
+    AsyncCommand current_command;
+    bool command_in_flight = false;
+    bool stop_sent = false;
+    std::chrono::steady_clock::time_point command_deadline;
+    std::atomic<bool> timed_out{false};  // a search got no bestmove even after "stop"
+
+    // Pondering: after "bestmove X ponder Y" and X played, search the position
+    // after Y while the user thinks, a matching user move turns it into ponderhit
+    enum PonderState { PONDER_IDLE, PONDERING, PONDER_HIT };
+    std::atomic<bool> ponder_enabled{false};
+    PonderState ponder_state = PONDER_IDLE;
+    Move ponder_best;  // engine move of the last search
+    Move ponder_move;  // reply it expects
+    ResponseCallback ponder_hit_callback;
 
     // Callbacks
     MoveCallback move_callback;
     ErrorCallback error_callback;
 
 public:
-    UCIEngine() : engine_pid(-1), is_running(false), command_thread_running(false) {
+    UCIEngine() : engine_pid(-1), is_running(false) {
         engine_stdin[0] = engine_stdin[1] = -1;
         engine_stdout[0] = engine_stdout[1] = -1;
     }
@@ -73,39 +151,74 @@ public:
     }
 
     bool startEngine(bool debug = false, const std::string& enginePath = "/usr/games/gnuchess");
+    bool isRunning() const { return is_running; }
+
+    // Health checks for a supervisor
+    bool isResponsive(int timeout_ms);  // "isready" answered in time
+    bool isBusy();                      // a command is queued or waiting for its answer
+    bool hasTimedOut() const { return timed_out; }
+    void setCache(std::shared_ptr<EngineCache> shared) { cache = std::move(shared); }  // answer cache, off by default
     
     // Synchronous methods
     bool sendCommand(const std::string& command, bool silent = true);
     std::vector<std::string> getCommands();
     std::string getLastCommand();
-    std::string extractMove(std::string response);
+    static std::string extractMove(const std::string& response);
     void clearCommands();
     bool waitForResponse(const std::string& target, int timeout_ms = 5000);
     void searchWithDepthAndTimeout(int depth, int max_time_ms);
-    std::string sendMove(const std::string& move);
-    std::string getMovesHistory();
-    void addMoveToHistory(const std::string& move);
+    Move sendMove(Move move);
+    const std::vector<Move>& getMovesHistory() const { return moves_history; }
+    void addMoveToHistory(Move move);
     void newGame();
     void setFenInitBoard(const std::string& fen);
     void shutdown();
     void setDifficult(int difficult);
     void setMoveTime(uint32_t move_time);
+    void setPonder(bool enabled);  // think on the user's time
+
+    // Blocking search of a single FEN, for batch analysis (no cache, no history)
+    bool analyzeFen(const std::string& fen, std::string& best_move, std::string& score);
 
-    // Async method with callbacks
-    void sendMoveAsync(const std::string& move, MoveCallback callback = nullptr);
+    // Async searches: after appending a move to the game, or from a FEN position
+    void sendMoveAsync(Move move, MoveCallback callback = nullptr);
+    void sendPositionAsync(const std::string& fen, MoveCallback callback = nullptr);
+    
+    /**
+     * Latest progress of the engine search, only one thread may call this
+     * @param info: receives the last published search info
+     * @return true when it changed since the previous call
+     */
+    bool getSearchInfo(SearchInfo& info);
     
-    // Callback setters
+    // Callback setters, errors come from the reactor thread (engine exit, lost search)
     void setMoveCallback(MoveCallback callback);
     void setErrorCallback(ErrorCallback callback);
 
 private:
     void observerLoop();
-    void commandProcessorLoop();
-    void processEngineOutput(const char* data, std::string& partial_line);
-    bool isCommandResponse(const std::string& response);
+    bool readEngineOutput(std::string& partial_line);
+    void processEngineOutput(const char* data, size_t length, std::string& partial_line);
+    void processLine(std::string_view line);
+    void parseInfo(std::string_view line);
+    void publishSearchInfo();
+    void checkEarlyStop();
+    void wake();
+    void startNextCommand();
+    void completeCommand(const std::string& response);
+    void expireCommand();
+    bool waitForExit(int timeout_ms);
+    bool isCommandResponse(std::string_view response);
     void storeCommandResponse(const std::string& response);
-    void notifyMove(const std::string& move);
+    void notifyMove(Move move);
     void notifyError(const std::string& error);
+    void trackMove(Move move);
+    const std::string& positionCommand(Move extra = Move());
+    void searchAsync(const std::string& position_command, MoveCallback callback);
+    ResponseCallback bestMoveCallback(MoveCallback callback);
+    void expectPonder(const ChessBoard& searched, Move best, const std::string& response);
+    void startPondering();
+    void stopPondering();
 };
 
 #endif // UCI_ENGINE_H
@@ -1,6 +1,9 @@
+#include <cstdlib>
 #include <iostream>
 #include <string>
 
+#include "batch_analysis.h"
+
 void renderChessboardChars();
 void renderChessboardSDL(std::string fen);
 void renderChessboardNcurses();
@@ -15,8 +18,16 @@ void printHelp() {
     std::cout << "              Render chessboard using SDL2 graphics (default)\n";
     std::cout << "  --chars     Render chessboard using ASCII characters\n";
     std::cout << "  --ncurses   Render chessboard using interactive ncurses interface\n";
+    std::cout << "  --fen FEN   Start the SDL2 board from a FEN position\n";
     std::cout << "  --help      Show this help message\n";
     std::cout << "\n";
+    std::cout << "Batch analysis (headless):\n";
+    std::cout << "  --analyze FILE  Analyze every position of an .epd or .pgn file\n";
+    std::cout << "  --jobs N        Number of gnuchess processes (default: one per CPU core)\n";
+    std::cout << "  --depth N       Search depth (default: depth_difficulty from config.yml)\n";
+    std::cout << "  --movetime S    Seconds per position (default: max_time_per_move from config.yml)\n";
+    std::cout << "  --output FILE   Write results to FILE instead of stdout\n";
+    std::cout << "\n";
     std::cout << "Controls (SDL mode):\n";
     std::cout << "  Q or ESC   Quit the application\n";
     std::cout << "\n";
@@ -30,6 +41,7 @@ void printHelp() {
 int main(int argc, char* argv[]) {
     std::string mode = "SDL";
     std::string fen = "";
+    AnalysisOptions analysis;
     
     // Parse command line arguments
     for (int i = 1; i < argc; ++i) {
@@ -42,6 +54,17 @@ int main(int argc, char* argv[]) {
         } else if (arg == "--fen") { 
             if (i + 1 <= argc) fen = argv[i + 1];
             break;
+        } else if (arg == "--analyze" && i + 1 < argc) {
+            mode = "analyze";
+            analysis.inputPath = argv[++i];
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            analysis.jobs = std::atoi(argv[++i]);
+        } else if (arg == "--depth" && i + 1 < argc) {
+            analysis.depth = std::atoi(argv[++i]);
+        } else if (arg == "--movetime" && i + 1 < argc) {
+            analysis.moveTime = std::atoi(argv[++i]);
+        } else if (arg == "--output" && i + 1 < argc) {
+            analysis.outputPath = argv[++i];
         } else if (arg == "--help") {
             printHelp();
             return 0;
@@ -52,6 +75,10 @@ int main(int argc, char* argv[]) {
         }
     }
     
+    if (mode == "analyze") {
+        return runBatchAnalysis(analysis);
+    }
+
     std::cout << "GNUChess frontend - " << mode << " mode\n";
     std::cout << "============================\n";
     
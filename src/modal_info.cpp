@@ -61,6 +61,11 @@ void GameInfoModal::render() {
     
     // Render points and timers in horizontal alignment
     renderPointsAndTimersSection(currentY + 85);
+
+    // Render engine search progress below
+    if (!engineInfo.empty()) {
+        drawText(engineInfo, modalX + sectionPadding, currentY + 125, {200, 200, 200, 255}, 14);
+    }
     
     // Render close instruction
     renderBottomLine("Press I to toggle");
@@ -82,6 +87,8 @@ void GameInfoModal::setWhiteTimer(const std::string& time) { whiteTimer = time;
 
 void GameInfoModal::setBlackTimer(const std::string& time) { blackTimer = time; }
 
+void GameInfoModal::setEngineInfo(const std::string& info) { engineInfo = info; }
+
 void GameInfoModal::renderCapturedPiecesSection(int startY, const std::string& title, 
                                                const std::vector<ChessPiece>& wpieces, const std::vector<ChessPiece>& bpieces) {
     // Draw section title
@@ -25,6 +25,7 @@ public:
     void setPoints(const std::string& points, bool isNegative = false);
     void setWhiteTimer(const std::string& time);
     void setBlackTimer(const std::string& time);
+    void setEngineInfo(const std::string& info);
 
 private:
     std::vector<ChessPiece> whiteCapturedPieces;
@@ -33,6 +34,7 @@ private:
     std::string currentPoints;
     std::string whiteTimer;
     std::string blackTimer;
+    std::string engineInfo;  // live search depth, eval and speed
 
     bool isNegativePoints = false;
     
@@ -5,7 +5,7 @@
 #include <algorithm>
 
 SettingsModal::SettingsModal(SDL_Renderer* renderer, int screenWidth, int screenHeight, ConfigManager* configManager)
-    : ModalBase(renderer, screenWidth, screenHeight, 250, 220), 
+    : ModalBase(renderer, screenWidth, screenHeight, 250, 260), 
       focusedElement(-1), configManager(configManager) {
     
     // Load settings from config file if config manager is available
@@ -17,6 +17,10 @@ SettingsModal::SettingsModal(SDL_Renderer* renderer, int screenWidth, int screen
             currentSettings.maxTimePerMove = loadedSettings.maxTimePerMove;
             currentSettings.matchTime = loadedSettings.matchTime;
             currentSettings.soundEnabled = loadedSettings.soundEnabled;
+            currentSettings.builtinEngine = loadedSettings.builtinEngine;
+            currentSettings.ponder = loadedSettings.ponder;
+            currentSettings.bookPath = loadedSettings.bookPath;
+            currentSettings.syzygyPath = loadedSettings.syzygyPath;
             std::cout << "[CONF] Settings loaded from config file" << std::endl;
         } else {
             std::cout << "[CONF] Using default settings" << std::endl;
@@ -77,10 +81,21 @@ void SettingsModal::initializeUI() {
     // Sound checkbox
     Checkbox soundCheckbox;
     soundCheckbox.rect = {modalX + padding, currentY, elementWidth, elementHeight+10};
+    soundCheckbox.name = "Sound";
     soundCheckbox.label = "Sound: " + std::string(currentSettings.soundEnabled ? "ON" : "OFF");
     soundCheckbox.value = &currentSettings.soundEnabled;
     soundCheckbox.hovered = false;
     checkboxes.push_back(soundCheckbox);
+    currentY += elementHeight + 20;
+
+    // Built-in engine checkbox
+    Checkbox engineCheckbox;
+    engineCheckbox.rect = {modalX + padding, currentY, elementWidth, elementHeight+10};
+    engineCheckbox.name = "Built-in Engine";
+    engineCheckbox.label = "Built-in Engine: " + std::string(currentSettings.builtinEngine ? "ON" : "OFF");
+    engineCheckbox.value = &currentSettings.builtinEngine;
+    engineCheckbox.hovered = false;
+    checkboxes.push_back(engineCheckbox);
 }
 
 
@@ -93,6 +108,10 @@ void SettingsModal::saveSettingsToFile() {
         settingsToSave.maxTimePerMove = currentSettings.maxTimePerMove;
         settingsToSave.matchTime = currentSettings.matchTime;
         settingsToSave.soundEnabled = currentSettings.soundEnabled;
+        settingsToSave.builtinEngine = currentSettings.builtinEngine;
+        settingsToSave.ponder = currentSettings.ponder;
+        settingsToSave.bookPath = currentSettings.bookPath;
+        settingsToSave.syzygyPath = currentSettings.syzygyPath;
         
         if (configManager->saveSettings(settingsToSave)) {
             std::cout << "[CONF] Settings saved to config file" << std::endl;
@@ -126,7 +145,7 @@ bool SettingsModal::handleEvent(const SDL_Event& e) {
                     if (mouseX >= checkbox.rect.x && mouseX <= checkbox.rect.x + checkbox.rect.w &&
                         mouseY >= checkbox.rect.y && mouseY <= checkbox.rect.y + checkbox.rect.h) {
                         *checkbox.value = !(*checkbox.value);
-                        checkbox.label = "Sound: " + std::string(*checkbox.value ? "ON" : "OFF");
+                        checkbox.label = checkbox.name + ": " + std::string(*checkbox.value ? "ON" : "OFF");
                         focusedElement = sliders.size() + i; // Set focus to this checkbox
                         // Apply changes immediately
                         if (onSettingsChanged) {
@@ -254,7 +273,7 @@ bool SettingsModal::handleEvent(const SDL_Event& e) {
                         // Toggle checkbox
                         auto& checkbox = checkboxes[checkboxIndex];
                         *checkbox.value = !(*checkbox.value);
-                        checkbox.label = "Sound: " + std::string(*checkbox.value ? "ON" : "OFF");
+                        checkbox.label = checkbox.name + ": " + std::string(*checkbox.value ? "ON" : "OFF");
                         if (onSettingsChanged) {
                             onSettingsChanged(currentSettings);
                         }
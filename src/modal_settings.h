@@ -26,6 +26,10 @@ public:
         int maxTimePerMove = 2;       // seconds (0-300)
         int matchTime = 10;            // minutes (0-60)
         bool soundEnabled = false;
+        bool builtinEngine = false;
+        bool ponder = true;           // Only editable in config.yml
+        std::string bookPath;         // Only editable in config.yml
+        std::string syzygyPath;       // Only editable in config.yml
     };
     
     // Get current settings
@@ -43,6 +47,7 @@ private:
     // UI elements
     struct Checkbox {
         SDL_Rect rect;
+        std::string name;
         std::string label;
         bool* value;
         bool hovered;
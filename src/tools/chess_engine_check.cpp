@@ -0,0 +1,381 @@
+// Engine regression checks
+//
+// Drives the engines through the game flows that once left the GUI waiting
+// for a move forever (a new game during a search, a replaced request, a
+// ponder search ending before its ponderhit) or fed gnuchess a malformed
+// position (pondering after a capture), and exits non-zero when an answer is
+// missing or wrong.
+//
+// The UCI checks talk to this same binary started with --uci, a scripted
+// engine that answers instantly, holds deep searches until "stop" and
+// refuses malformed position commands.
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "engine/bitboard.h"
+#include "engine/engine_supervisor.h"
+#include "engine/search_engine.h"
+#include "engine/uci_engine.h"
+
+namespace {
+
+// Every answer one request got, in arrival order
+struct Answers {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<Move> moves;
+
+  SearchEngine::MoveCallback callback() {
+    return [this](Move move) {
+      std::lock_guard<std::mutex> lock(mutex);
+      moves.push_back(move);
+      cv.notify_all();
+    };
+  }
+
+  /**
+   * Wait until at least count answers arrived
+   * @return false on timeout
+   */
+  bool wait(size_t count, int timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] { return moves.size() >= count; });
+  }
+
+  size_t count() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return moves.size();
+  }
+};
+
+// =========================================================================
+// SCRIPTED UCI ENGINE - this binary with --uci
+// =========================================================================
+
+// Deterministic choice: a capture, else a pawn move, else the first legal move
+Move pick_move(const ChessBoard& board) {
+  MoveList moves;
+  board.generate_legal_moves(moves);
+  if (moves.empty()) return Move();
+  for (const Move& move : moves) {
+    if (move.is_en_passant() || board.get_piece_at(static_cast<ChessBoard::Square>(move.to())) != ChessBoard::NONE) {
+      return move;
+    }
+  }
+  for (const Move& move : moves) {
+    if (board.get_piece_at(static_cast<ChessBoard::Square>(move.from())) == ChessBoard::PAWN) return move;
+  }
+  return moves[0];
+}
+
+/**
+ * Follow a "position" command: startpos or a full six field FEN, then
+ * optionally "moves" and legal moves only
+ * @return false when the command is malformed
+ */
+bool parse_position(const std::string& command, ChessBoard& board) {
+  std::istringstream in(command);
+  std::string token;
+  in >> token >> token;
+  if (token == "startpos") {
+    board.set_initial_position();
+  } else if (token == "fen") {
+    std::string fen;
+    for (int field = 0; field < 6 && in >> token; field++) fen += (field ? " " : "") + token;
+    if (!board.set_fen(fen)) return false;
+  } else {
+    return false;
+  }
+
+  if (!(in >> token)) return true;
+  if (token != "moves") return false;
+  while (in >> token) {
+    Move move = board.find_uci_move(token);
+    if (move.is_null()) return false;
+    board.make_move(move);
+  }
+  return true;
+}
+
+int run_scripted_engine() {
+  ChessBoard board;
+  bool valid = true;
+  bool searching = false;
+
+  auto answer = [&]() {
+    searching = false;
+    Move best = valid ? pick_move(board) : Move();
+    if (best.is_null()) {
+      std::cout << "bestmove (none)" << std::endl;
+      return;
+    }
+    ChessBoard after = board;
+    after.make_move(best);
+    Move reply = pick_move(after);
+    char uci[6];
+    std::cout << "bestmove " << std::string(uci, best.to_uci(uci));
+    if (!reply.is_null()) std::cout << " ponder " << std::string(uci, reply.to_uci(uci));
+    std::cout << std::endl;
+  };
+
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    if (line == "uci") {
+      std::cout << "id name chess-engine-check\nuciok" << std::endl;
+    } else if (line == "isready") {
+      std::cout << "readyok" << std::endl;
+    } else if (line.compare(0, 9, "position ") == 0) {
+      valid = parse_position(line, board);
+      if (!valid) std::cerr << "[CHCK] Malformed: " << line << std::endl;
+    } else if (line.compare(0, 3, "go ") == 0) {
+      // Deep searches wait for stop, ponder searches for ponderhit or stop,
+      // like a real search would. A depth 1 ponder search ends on its own
+      size_t depth = line.find("depth ");
+      int plies = depth == std::string::npos ? 0 : std::atoi(line.c_str() + depth + 6);
+      bool ponder = line.find(" ponder") != std::string::npos;
+      searching = true;
+      if (ponder && plies == 1) {
+        // Progress lines first, so the ponderhit can be on its way before the bestmove is read
+        std::string progress;
+        for (int node = 1; node <= 20000; node++) progress += "info depth 1 nodes " + std::to_string(node) + "\n";
+        std::cout << progress;
+        answer();
+      } else if (!ponder && plies < 30) {
+        answer();
+      }
+    } else if ((line == "stop" || line == "ponderhit") && searching) {
+      answer();
+    } else if (line == "quit") {
+      break;
+    }
+  }
+  return 0;
+}
+
+// =========================================================================
+// CHECKS
+// =========================================================================
+
+std::string engine_path;  // this binary, started with --uci as the scripted engine
+
+bool report(const std::string& name, bool ok, const std::string& detail) {
+  std::cout << std::left << std::setw(40) << name << (ok ? "  OK" : "  FAILED: " + detail) << std::endl;
+  return ok;
+}
+
+// Long enough that the search is still running when the game moves on
+void slowSearch(SearchEngine& engine) {
+  engine.setDifficult(40);
+  engine.setMoveTime(30);
+}
+
+bool check_builtin_new_game_during_search() {
+  Answers answers;
+  SearchEngine engine;
+  slowSearch(engine);
+  engine.sendPositionAsync(ChessBoard(), answers.callback());
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  engine.newGame();
+
+  if (!answers.wait(1, 2000)) return report("builtin: new game during a search", false, "no answer");
+  if (!answers.moves[0].is_null()) return report("builtin: new game during a search", false, "stale move");
+
+  // The engine still plays the new game
+  Answers next;
+  engine.setDifficult(2);
+  engine.sendPositionAsync(ChessBoard(), next.callback());
+  bool ok = next.wait(1, 5000) && !next.moves[0].is_null();
+  return report("builtin: new game during a search", ok, "no move in the new game");
+}
+
+bool check_builtin_new_game_before_search() {
+  Answers answers;
+  SearchEngine engine;
+  slowSearch(engine);
+  engine.sendPositionAsync(ChessBoard(), answers.callback());
+  engine.newGame();
+
+  bool ok = answers.wait(1, 2000) && answers.moves[0].is_null();
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  ok = ok && answers.count() == 1;
+  return report("builtin: new game before the search", ok, "expected one null answer");
+}
+
+bool check_builtin_replaced_request() {
+  Answers first;
+  Answers second;
+  SearchEngine engine;
+  slowSearch(engine);
+  engine.sendPositionAsync(ChessBoard(), first.callback());
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  engine.setDifficult(2);
+  engine.sendPositionAsync(ChessBoard(), second.callback());
+
+  bool ok = first.wait(1, 2000) && first.moves[0].is_null() && second.wait(1, 5000) && !second.moves[0].is_null();
+  return report("builtin: request replaced by a newer one", ok, "expected null, then a move");
+}
+
+bool check_supervisor_new_game_during_search() {
+  Answers answers;
+  EngineSupervisor engine;
+  engine.setDifficult(40);  // held by the scripted engine until stopped
+  engine.setMoveTime(1);
+  if (!engine.start(engine_path)) return report("supervisor: new game during a search", false, "no engine");
+
+  engine.sendMoveAsync(ChessBoard().find_uci_move("e2e4"), answers.callback());
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  engine.newGame();
+
+  if (!answers.wait(1, 500)) return report("supervisor: new game during a search", false, "no answer");
+  if (!answers.moves[0].is_null()) return report("supervisor: new game during a search", false, "stale move");
+
+  // The engine still plays the new game
+  Answers next;
+  engine.setDifficult(2);
+  engine.sendMoveAsync(ChessBoard().find_uci_move("d2d4"), next.callback());
+  bool ok = next.wait(1, 5000) && !next.moves[0].is_null();
+  ok = ok && answers.count() == 1;
+  return report("supervisor: new game during a search", ok, "no move in the new game");
+}
+
+// Every user move is the reply the engine expects, so each one is a ponder
+// hit. Both sides only play captures and pawn moves, so the engine ponders
+// right after an irreversible move, from a position command anchored at it.
+bool check_ponder_after_capture() {
+  Answers answers;
+  UCIEngine engine;
+  if (!engine.startEngine(false, engine_path)) return report("uci: ponder after a capture", false, "no engine");
+  engine.sendCommand("uci");
+  if (!engine.waitForResponse("uciok")) return report("uci: ponder after a capture", false, "no uciok");
+  engine.setPonder(true);
+  engine.setDifficult(2);
+  engine.setMoveTime(1);
+
+  ChessBoard board;
+  for (size_t round = 0; round < 15; round++) {
+    Move user = pick_move(board);
+    if (user.is_null()) break;
+    board.make_move(user);
+    engine.sendMoveAsync(user, answers.callback());
+    if (!answers.wait(round + 1, 2000)) return report("uci: ponder after a capture", false, "no answer");
+
+    Move reply = answers.moves[round];
+    if (reply.is_null()) {
+      MoveList moves;
+      board.generate_legal_moves(moves);
+      if (moves.empty()) break;
+      char fen[ChessBoard::FEN_BUFFER_SIZE];
+      board.get_fen(fen, sizeof(fen));
+      return report("uci: ponder after a capture", false, std::string("no move after ") + fen);
+    }
+    board.make_move(reply);
+    engine.addMoveToHistory(reply);
+  }
+  return report("uci: ponder after a capture", true, "");
+}
+
+// The engine ends its depth 1 ponder search by itself after a long run of
+// progress lines. The user plays the expected reply while those are still
+// being read, so the bestmove of the ponder search arrives before the
+// ponderhit the user move turns into. Every user move still gets one answer
+bool check_ponder_finished_before_hit() {
+  Answers answers;
+  UCIEngine engine;
+  if (!engine.startEngine(false, engine_path)) return report("uci: ponder ends before ponderhit", false, "no engine");
+  engine.sendCommand("uci");
+  if (!engine.waitForResponse("uciok")) return report("uci: ponder ends before ponderhit", false, "no uciok");
+  engine.setPonder(true);
+  engine.setDifficult(1);
+  engine.setMoveTime(1);
+
+  ChessBoard board;
+  SearchInfo info;
+  size_t asked = 0;
+  for (int round = 0; round < 40; round++) {
+    Move user = pick_move(board);
+    if (user.is_null()) break;
+    board.make_move(user);
+    engine.sendMoveAsync(user, answers.callback());
+    if (!answers.wait(++asked, 2000)) return report("uci: ponder ends before ponderhit", false, "no answer");
+
+    Move reply = answers.moves[asked - 1];
+    if (reply.is_null()) break;
+    board.make_move(reply);
+    engine.getSearchInfo(info);
+    engine.addMoveToHistory(reply);
+
+    // Halfway through the progress lines of the ponder search
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (!(engine.getSearchInfo(info) && info.nodes >= 10000) && std::chrono::steady_clock::now() < deadline) {
+    }
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  return report("uci: ponder ends before ponderhit", answers.count() == asked, "an extra answer");
+}
+
+void print_help() {
+  std::cout << "Chess engine regression checks\n";
+  std::cout << "==============================\n";
+  std::cout << "Usage:\n";
+  std::cout << "  chess-engine-check [options]\n";
+  std::cout << "\n";
+  std::cout << "Options:\n";
+  std::cout << "  --uci         Run as the scripted UCI engine the checks talk to\n";
+  std::cout << "  --help        Show this help message\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--uci") {
+      return run_scripted_engine();
+    } else if (arg == "--help") {
+      print_help();
+      return 0;
+    }
+    std::cerr << "Unknown option: " << arg << "\n";
+    std::cerr << "Use --help for usage information.\n";
+    return 2;
+  }
+
+  engine_path = std::filesystem::canonical("/proc/self/exe").string();
+
+  // Scripted answers must not reach the answer cache in the real home directory
+  char scratch[] = "/tmp/chess-engine-check.XXXXXX";
+  if (!mkdtemp(scratch)) {
+    std::cerr << "Could not create a scratch directory" << std::endl;
+    return 1;
+  }
+  setenv("HOME", scratch, 1);
+
+  bool all_ok = true;
+  all_ok &= check_builtin_new_game_during_search();
+  all_ok &= check_builtin_new_game_before_search();
+  all_ok &= check_builtin_replaced_request();
+  all_ok &= check_supervisor_new_game_during_search();
+  all_ok &= check_ponder_after_capture();
+  all_ok &= check_ponder_finished_before_hit();
+
+  std::error_code error;
+  std::filesystem::remove_all(scratch, error);
+
+  if (!all_ok) {
+    std::cerr << "ENGINE CHECK FAILED" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,249 @@
+// Perft benchmark and move generator correctness harness
+//
+// Runs perft on a suite of reference positions (or a single --fen), reports
+// nodes per second and exits non-zero when a node count does not match or an
+// illegal position loads.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include "engine/bitboard.h"
+
+namespace {
+
+struct PerftPosition {
+  const char* name;
+  const char* fen;
+  int default_depth;
+  std::vector<uint64_t> expected;  // node counts for depth 1, 2, ...
+};
+
+// Reference counts from the Chess Programming Wiki perft results
+const std::vector<PerftPosition> SUITE = {
+    {"startpos", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5,
+     {20, 400, 8902, 197281, 4865609, 119060324}},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4,
+     {48, 2039, 97862, 4085603, 193690690}},
+    {"position3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5,
+     {14, 191, 2812, 43238, 674624, 11030083}},
+    {"position4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4,
+     {6, 264, 9467, 422333, 15833292}},
+    {"position4-mirror", "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1", 4,
+     {6, 264, 9467, 422333, 15833292}},
+    {"position5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4,
+     {44, 1486, 62379, 2103487, 89941194}},
+    {"position6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4,
+     {46, 2079, 89890, 3894594, 164075551}},
+};
+
+// Positions set_fen must refuse, the board keeps its previous position
+struct RejectedPosition {
+  const char* name;
+  const char* fen;
+};
+
+const std::vector<RejectedPosition> REJECTED = {
+    {"no-white-king", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQ1BNR w kq - 0 1"},
+    {"no-kings", "8/8/8/4p3/4P3/8/8/8 w - - 0 1"},
+    {"two-black-kings", "k6k/8/8/8/8/8/8/4K3 w - - 0 1"},
+    {"two-white-kings", "4k3/8/8/8/8/8/8/K3K3 b - - 0 1"},
+    {"idle-side-checked", "4k3/8/8/8/8/8/8/4K2r b - - 0 1"},
+    {"idle-side-pawn-check", "4k3/3P4/8/8/8/8/8/4K3 w - - 0 1"},
+    {"kings-adjacent", "8/8/8/3kK3/8/8/8/8 w - - 0 1"},
+};
+
+// Optional perft transposition table: one entry per slot, always replace
+struct HashEntry {
+  uint64_t key;
+  uint64_t nodes;
+  int depth;
+};
+
+struct Options {
+  std::string fen;
+  int depth = 0;
+  bool divide = false;
+  bool bulk = true;
+  size_t hash_mb = 0;
+};
+
+std::vector<HashEntry> hash_table;
+uint64_t hash_mask = 0;
+
+uint64_t perft(ChessBoard& board, int depth, const Options& options) {
+  // Leaves are counted before any move generation or hash probe
+  if (depth == 0) return 1;
+
+  uint64_t key = 0;
+  if (!hash_table.empty()) {
+    key = board.get_hash();
+    const HashEntry& entry = hash_table[key & hash_mask];
+    if (entry.key == key && entry.depth == depth) return entry.nodes;
+  }
+
+  MoveList moves;
+  board.generate_legal_moves(moves);
+
+  // Bulk counting: the legal move count at depth 1 is the leaf count
+  if (depth == 1 && options.bulk) return moves.size();
+
+  uint64_t nodes = 0;
+  for (const Move& move : moves) {
+    board.make_move(move);
+    nodes += perft(board, depth - 1, options);
+    board.unmake_move(move);
+  }
+
+  if (!hash_table.empty()) hash_table[key & hash_mask] = {key, nodes, depth};
+  return nodes;
+}
+
+uint64_t divide(ChessBoard& board, int depth, const Options& options) {
+  if (depth == 0) return 1;
+
+  MoveList moves;
+  board.generate_legal_moves(moves);
+
+  uint64_t total = 0;
+  char uci[6];
+  for (const Move& move : moves) {
+    board.make_move(move);
+    uint64_t nodes = perft(board, depth - 1, options);
+    board.unmake_move(move);
+    move.to_uci(uci);
+    std::cout << uci << ": " << nodes << "\n";
+    total += nodes;
+  }
+  std::cout << "\nMoves: " << moves.size() << "\n";
+  return total;
+}
+
+/**
+ * Run one position and print a result line
+ * @return false on node count mismatch
+ */
+bool run_position(const std::string& name, const std::string& fen, int depth, uint64_t expected,
+                  const Options& options, uint64_t& total_nodes, double& total_seconds) {
+  ChessBoard board;
+  if (!board.set_fen(fen)) {
+    std::cerr << "Invalid FEN: " << fen << std::endl;
+    return false;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  uint64_t nodes = options.divide ? divide(board, depth, options) : perft(board, depth, options);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  total_nodes += nodes;
+  total_seconds += seconds;
+
+  bool ok = expected == 0 || nodes == expected;
+  std::cout << std::left << std::setw(18) << name << " depth " << depth << "  nodes " << std::setw(12) << nodes
+            << std::right << std::fixed << std::setprecision(3) << std::setw(9) << seconds << " s  "
+            << std::setw(12) << static_cast<uint64_t>(seconds > 0 ? nodes / seconds : 0) << " nps";
+  if (expected != 0) std::cout << (ok ? "  OK" : "  MISMATCH (expected " + std::to_string(expected) + ")");
+  std::cout << std::endl;
+  return ok;
+}
+
+/**
+ * Check that every REJECTED position fails to load and leaves the board alone
+ * @return false when one was accepted
+ */
+bool check_rejected() {
+  bool all_ok = true;
+  for (const RejectedPosition& position : REJECTED) {
+    ChessBoard board;
+    uint64_t before = board.get_hash();
+    bool ok = !board.set_fen(position.fen) && board.get_hash() == before;
+    std::cout << std::left << std::setw(22) << position.name << " rejected" << (ok ? "  OK" : "  ACCEPTED")
+              << std::endl;
+    all_ok &= ok;
+  }
+  return all_ok;
+}
+
+void print_help() {
+  std::cout << "Chess perft benchmark\n";
+  std::cout << "=====================\n";
+  std::cout << "Usage:\n";
+  std::cout << "  chess-perft [options]\n";
+  std::cout << "\n";
+  std::cout << "Options:\n";
+  std::cout << "  --fen FEN     Run a single position instead of the reference suite\n";
+  std::cout << "  --depth N     Search depth (suite default is per position)\n";
+  std::cout << "  --divide      Print the node count below every root move\n";
+  std::cout << "  --no-bulk     Make every leaf move instead of counting them\n";
+  std::cout << "  --hash MB     Use a transposition table of the given size\n";
+  std::cout << "  --help        Show this help message\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--fen" && i + 1 < argc) {
+      options.fen = argv[++i];
+    } else if (arg == "--depth" && i + 1 < argc) {
+      options.depth = std::atoi(argv[++i]);
+    } else if (arg == "--divide") {
+      options.divide = true;
+    } else if (arg == "--no-bulk") {
+      options.bulk = false;
+    } else if (arg == "--hash" && i + 1 < argc) {
+      options.hash_mb = std::strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--help") {
+      print_help();
+      return 0;
+    } else {
+      std::cerr << "Unknown option: " << arg << "\n";
+      std::cerr << "Use --help for usage information.\n";
+      return 2;
+    }
+  }
+
+  if (options.hash_mb > 0) {
+    // Round down to a power of two entry count for mask indexing
+    size_t entries = 1;
+    while (entries * 2 * sizeof(HashEntry) <= options.hash_mb * 1024 * 1024) entries *= 2;
+    hash_table.assign(entries, HashEntry{0, 0, -1});
+    hash_mask = entries - 1;
+  }
+
+  uint64_t total_nodes = 0;
+  double total_seconds = 0;
+  bool all_ok = true;
+
+  if (!options.fen.empty()) {
+    int depth = options.depth > 0 ? options.depth : 5;
+    all_ok = run_position("custom", options.fen, depth, 0, options, total_nodes, total_seconds);
+  } else {
+    for (const PerftPosition& position : SUITE) {
+      int depth = options.depth > 0 ? options.depth : position.default_depth;
+      uint64_t expected = depth <= static_cast<int>(position.expected.size()) ? position.expected[depth - 1] : 0;
+      all_ok &= run_position(position.name, position.fen, depth, expected, options, total_nodes, total_seconds);
+    }
+    std::cout << "\n";
+    if (!check_rejected()) {
+      std::cerr << "PERFT FAILED: an illegal position was loaded" << std::endl;
+      return 1;
+    }
+  }
+
+  std::cout << "\nTotal nodes " << total_nodes << " in " << std::fixed << std::setprecision(3) << total_seconds
+            << " s, " << static_cast<uint64_t>(total_seconds > 0 ? total_nodes / total_seconds : 0) << " nps\n";
+
+  if (!all_ok) {
+    std::cerr << "PERFT FAILED: node count mismatch" << std::endl;
+    return 1;
+  }
+  return 0;
+}